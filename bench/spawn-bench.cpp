@@ -0,0 +1,409 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+// Headless spawn benchmark: starts libobs with a synthetic
+// canvas, loads the plugin, and calls its 'spawn' proc at a
+// fixed rate against a fixture folder.
+//
+// With --enqueue it calls the 'enqueue' proc instead, which
+// takes the vendor request's path through the spawn queue into
+// the source's overlay. Trigger-to-visible is then the
+// plugin's own enqueue-to-media_started timing, read back
+// through its 'stats' proc.
+//
+//   random-media-bench --folder <dir> [--rate 10] [--duration 10]
+//                      [--spawn-count 1] [--max-active 5]
+//                      [--enqueue]
+//                      [--plugins <bin> <data>] [--module <path>]
+
+#include <obs.h>
+#include <util/platform.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../src/latency-histogram.h"
+
+#ifndef BENCH_MODULE_PATH
+#define BENCH_MODULE_PATH ""
+#endif
+#ifndef BENCH_DATA_PATH
+#define BENCH_DATA_PATH ""
+#endif
+
+#if defined(_WIN32)
+#define BENCH_GRAPHICS "libobs-d3d11"
+#else
+#define BENCH_GRAPHICS "libobs-opengl"
+#endif
+
+struct bench_options {
+	std::string folder;
+	std::string module = BENCH_MODULE_PATH;
+	std::string module_data = BENCH_DATA_PATH;
+	std::string plugins_bin;
+	std::string plugins_data;
+	double rate = 10.0;    // spawn calls per second
+	double duration = 10.0; // seconds of spawning
+	double drain = 3.0;    // seconds to wait for late starts
+	int spawn_count = 1;
+	int max_active = 5;
+	bool enqueue = false; // through the queue, not 'spawn'
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+};
+
+// ============================================================
+//  Trigger-to-visible tracking
+// ============================================================
+// obs_scene_add emits 'item_add' synchronously, so the trigger
+// time of the call in flight is known to the handler
+struct visible_ctx {
+	uint64_t trigger_ns;
+	obs_source_t *source;
+	bool done = false;
+};
+
+static uint64_t s_trigger_ns = 0;
+static std::mutex s_ctx_mutex;
+static std::deque<std::unique_ptr<visible_ctx>> s_ctx;
+static latency_histogram s_visible;
+static latency_histogram s_call;
+
+static void on_started(void *param, calldata_t *)
+{
+	auto *ctx = static_cast<visible_ctx *>(param);
+	std::lock_guard<std::mutex> lk(s_ctx_mutex);
+	if (ctx->done)
+		return;
+	ctx->done = true;
+	s_visible.record(os_gettime_ns() - ctx->trigger_ns);
+	signal_handler_disconnect(
+		obs_source_get_signal_handler(ctx->source),
+		"media_started", on_started, ctx);
+}
+
+static void on_item_add(void *, calldata_t *cd)
+{
+	auto *item =
+		static_cast<obs_sceneitem_t *>(calldata_ptr(cd, "item"));
+	obs_source_t *src = obs_sceneitem_get_source(item);
+
+	auto ctx = std::make_unique<visible_ctx>();
+	ctx->trigger_ns = s_trigger_ns;
+	ctx->source = src;
+	std::lock_guard<std::mutex> lk(s_ctx_mutex);
+	signal_handler_connect(obs_source_get_signal_handler(src),
+			       "media_started", on_started, ctx.get());
+	s_ctx.push_back(std::move(ctx));
+}
+
+// Pooled sources outlive their items, so handlers of spawns
+// that never started are taken off before teardown
+static void disconnect_pending(void)
+{
+	std::lock_guard<std::mutex> lk(s_ctx_mutex);
+	for (auto &ctx : s_ctx) {
+		if (ctx->done)
+			continue;
+		ctx->done = true;
+		signal_handler_disconnect(
+			obs_source_get_signal_handler(ctx->source),
+			"media_started", on_started, ctx.get());
+	}
+}
+
+// ============================================================
+//  Process metrics
+// ============================================================
+static uint64_t peak_rss_bytes(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc,
+				  sizeof(pmc)))
+		return 0;
+	return (uint64_t)pmc.PeakWorkingSetSize;
+#else
+	struct rusage ru = {};
+	getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+	return (uint64_t)ru.ru_maxrss;
+#else
+	return (uint64_t)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static size_t count_sources(void)
+{
+	size_t n = 0;
+	obs_enum_all_sources(
+		[](void *param, obs_source_t *) {
+			++*static_cast<size_t *>(param);
+			return true;
+		},
+		&n);
+	return n;
+}
+
+// ============================================================
+//  Setup
+// ============================================================
+static bool parse_args(int argc, char **argv, bench_options &o)
+{
+	for (int i = 1; i < argc; ++i) {
+		const char *a = argv[i];
+		bool more = i + 1 < argc;
+		if (!strcmp(a, "--folder") && more)
+			o.folder = argv[++i];
+		else if (!strcmp(a, "--module") && more)
+			o.module = argv[++i];
+		else if (!strcmp(a, "--module-data") && more)
+			o.module_data = argv[++i];
+		else if (!strcmp(a, "--plugins") && i + 2 < argc) {
+			o.plugins_bin = argv[++i];
+			o.plugins_data = argv[++i];
+		} else if (!strcmp(a, "--rate") && more)
+			o.rate = atof(argv[++i]);
+		else if (!strcmp(a, "--duration") && more)
+			o.duration = atof(argv[++i]);
+		else if (!strcmp(a, "--drain") && more)
+			o.drain = atof(argv[++i]);
+		else if (!strcmp(a, "--spawn-count") && more)
+			o.spawn_count = atoi(argv[++i]);
+		else if (!strcmp(a, "--max-active") && more)
+			o.max_active = atoi(argv[++i]);
+		else if (!strcmp(a, "--enqueue"))
+			o.enqueue = true;
+		else if (!strcmp(a, "--canvas") && i + 2 < argc) {
+			o.width = (uint32_t)atoi(argv[++i]);
+			o.height = (uint32_t)atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "unknown argument: %s\n", a);
+			return false;
+		}
+	}
+	if (o.folder.empty() || o.module.empty() || o.rate <= 0.0) {
+		fprintf(stderr, "usage: %s --folder <dir> [options]\n",
+			argv[0]);
+		return false;
+	}
+	return true;
+}
+
+static bool start_obs(const bench_options &o)
+{
+	if (!obs_startup("en-US", nullptr, nullptr))
+		return false;
+
+	struct obs_audio_info oai = {};
+	oai.samples_per_sec = 48000;
+	oai.speakers = SPEAKERS_STEREO;
+	if (!obs_reset_audio(&oai))
+		return false;
+
+	struct obs_video_info ovi = {};
+	ovi.graphics_module = BENCH_GRAPHICS;
+	ovi.fps_num = 60;
+	ovi.fps_den = 1;
+	ovi.base_width = o.width;
+	ovi.base_height = o.height;
+	ovi.output_width = o.width;
+	ovi.output_height = o.height;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.colorspace = VIDEO_CS_DEFAULT;
+	ovi.range = VIDEO_RANGE_DEFAULT;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+	ovi.gpu_conversion = true;
+	if (obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "obs_reset_video failed (%s)\n",
+			BENCH_GRAPHICS);
+		return false;
+	}
+
+	// ffmpeg_source and the audio filters live in stock plugins
+	if (!o.plugins_bin.empty())
+		obs_add_module_path(o.plugins_bin.c_str(),
+				    o.plugins_data.c_str());
+	obs_load_all_modules();
+
+	obs_module_t *mod = nullptr;
+	if (obs_open_module(&mod, o.module.c_str(),
+			    o.module_data.c_str()) != MODULE_SUCCESS ||
+	    !obs_init_module(mod)) {
+		fprintf(stderr, "failed to load %s\n", o.module.c_str());
+		return false;
+	}
+	obs_post_load_modules();
+	return true;
+}
+
+// ============================================================
+//  Report
+// ============================================================
+static void print_latency(const char *label, obs_data_t *stats,
+			  const char *name)
+{
+	obs_data_t *h = obs_data_get_obj(stats, name);
+	printf("%s (n=%lld): p50 %.3f  p95 %.3f  p99 %.3f\n", label,
+	       obs_data_get_int(h, "count"),
+	       obs_data_get_double(h, "p50_ms"),
+	       obs_data_get_double(h, "p95_ms"),
+	       obs_data_get_double(h, "p99_ms"));
+	obs_data_release(h);
+}
+
+// ============================================================
+//  Run
+// ============================================================
+int main(int argc, char **argv)
+{
+	bench_options o;
+	if (!parse_args(argc, argv, o))
+		return 1;
+	if (!start_obs(o)) {
+		obs_shutdown();
+		return 1;
+	}
+
+	obs_scene_t *scene = obs_scene_create("bench");
+	obs_source_t *scene_src = obs_scene_get_source(scene);
+	obs_set_output_source(0, scene_src);
+	if (!o.enqueue)
+		signal_handler_connect(
+			obs_source_get_signal_handler(scene_src),
+			"item_add", on_item_add, nullptr);
+	size_t baseline = count_sources();
+
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "folder", o.folder.c_str());
+	obs_data_set_int(settings, "spawn_count", o.spawn_count);
+	obs_data_set_int(settings, "max_active", o.max_active);
+	obs_data_set_bool(settings, "hide_on_end", true);
+	obs_source_t *rms = obs_source_create_private(
+		"random_media_source", "bench", settings);
+	obs_data_release(settings);
+	if (!rms) {
+		fprintf(stderr, "random_media_source not registered\n");
+		obs_shutdown();
+		return 1;
+	}
+	proc_handler_t *ph = obs_source_get_proc_handler(rms);
+	// The overlay only plays while the source is shown
+	obs_sceneitem_t *rms_item =
+		o.enqueue ? obs_scene_add(scene, rms) : nullptr;
+
+	uint64_t interval = (uint64_t)(1000000000.0 / o.rate);
+	uint64_t start = os_gettime_ns();
+	uint64_t end = start + (uint64_t)(o.duration * 1e9);
+	uint64_t next = start;
+	uint64_t calls = 0, ok = 0;
+
+	while (next < end) {
+		os_sleepto_ns(next);
+		next += interval;
+
+		calldata_t cd;
+		calldata_init(&cd);
+		calldata_set_ptr(&cd, "scene", scene);
+		s_trigger_ns = os_gettime_ns();
+		if (o.enqueue) {
+			proc_handler_call(ph, "enqueue", &cd);
+			ok += calldata_int(&cd, "ticket") != 0;
+		} else {
+			proc_handler_call(ph, "spawn", &cd);
+			ok += calldata_bool(&cd, "spawned");
+		}
+		s_call.record(os_gettime_ns() - s_trigger_ns);
+		calls++;
+		calldata_free(&cd);
+	}
+	double elapsed = (double)(os_gettime_ns() - start) / 1e9;
+	os_sleep_ms((uint32_t)(o.drain * 1000.0));
+	disconnect_pending();
+
+	obs_data_t *stats = obs_data_create();
+	if (o.enqueue) {
+		calldata_t cd;
+		calldata_init(&cd);
+		calldata_set_ptr(&cd, "stats", stats);
+		proc_handler_call(ph, "stats", &cd);
+		calldata_free(&cd);
+		obs_sceneitem_remove(rms_item);
+	} else {
+		signal_handler_disconnect(
+			obs_source_get_signal_handler(scene_src),
+			"item_add", on_item_add, nullptr);
+	}
+	obs_source_release(rms);
+	obs_set_output_source(0, nullptr);
+	obs_scene_release(scene);
+	obs_wait_for_destroy_queue();
+	// The bench scene itself is part of the baseline
+	size_t remaining = count_sources();
+	size_t leaked = remaining + 1 > baseline
+				? remaining + 1 - baseline
+				: 0;
+
+	printf("calls:              %llu\n", (unsigned long long)calls);
+	if (o.enqueue)
+		printf("queued:             %llu\n",
+		       (unsigned long long)ok);
+	else
+		printf("spawned:            %llu\n",
+		       (unsigned long long)ok);
+	printf("spawns_per_sec:     %.2f\n", (double)ok / elapsed);
+	printf("call_ms:            p50 %.3f  p95 %.3f  p99 %.3f\n",
+	       s_call.percentile_ms(0.50), s_call.percentile_ms(0.95),
+	       s_call.percentile_ms(0.99));
+	if (o.enqueue) {
+		// Items lost to a full queue or the max_active cap
+		printf("dropped:            %lld\n",
+		       obs_data_get_int(stats, "dropped"));
+		print_latency("visible_ms lookahead", stats,
+			      "first_frame_lookahead");
+		print_latency("visible_ms cold", stats,
+			      "first_frame_cold");
+	} else {
+		printf("visible_ms (n=%llu): p50 %.3f  p95 %.3f"
+		       "  p99 %.3f\n",
+		       (unsigned long long)s_visible.count(),
+		       s_visible.percentile_ms(0.50),
+		       s_visible.percentile_ms(0.95),
+		       s_visible.percentile_ms(0.99));
+	}
+	obs_data_release(stats);
+	printf("peak_rss_mb:        %.1f\n",
+	       (double)peak_rss_bytes() / (1024.0 * 1024.0));
+	printf("leaked_sources:     %zu\n", leaked);
+
+	obs_shutdown();
+	return leaked ? 2 : 0;
+}
@@ -0,0 +1,350 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "audio-bus.h"
+
+#include <obs-module.h>
+#include <media-io/audio-io.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define BUS_SOURCE_ID "random_media_audio_bus"
+
+// Output channels 1-6 belong to the frontend's global audio
+// devices; the bus takes the first free one from here up
+static constexpr uint32_t BUS_CHANNEL_FIRST = 40;
+// Frames mixed per pump iteration
+static constexpr size_t BUS_BLOCK = AUDIO_OUTPUT_FRAMES;
+// An input must buffer this many blocks before it is mixed,
+// so capture jitter does not drain it mid-block
+static constexpr size_t BUS_PRIME_BLOCKS = 2;
+// Most blocks mixed back to back after the pump oversleeps
+static constexpr uint64_t BUS_MAX_CATCHUP = 8;
+
+// Per-input FIFO of planar float audio in the OBS output format
+struct bus_input {
+	obs_weak_source_t *weak = nullptr;
+	obs_source_t *media = nullptr; // identity only, not a ref
+	float gain = 1.0f;
+	std::mutex mutex;
+	std::vector<float> ring[MAX_AUDIO_CHANNELS];
+	size_t capacity = 0;
+	size_t head = 0;
+	size_t avail = 0;
+	bool primed = false;
+};
+
+struct audio_bus {
+	obs_source_t *output = nullptr;
+	uint32_t channel = 0;
+	size_t channels = 2;
+	uint32_t sample_rate = 48000;
+	speaker_layout speakers = SPEAKERS_STEREO;
+
+	std::mutex inputs_mutex;
+	std::vector<bus_input *> inputs;
+
+	std::atomic<bool> stop{false};
+	std::thread pump;
+};
+
+// ============================================================
+//  Capture
+// ============================================================
+static void bus_capture_cb(void *param, obs_source_t *,
+			   const struct audio_data *audio, bool)
+{
+	auto *in = static_cast<bus_input *>(param);
+	std::lock_guard<std::mutex> lk(in->mutex);
+
+	size_t frames = std::min<size_t>(audio->frames, in->capacity);
+	// Overflow: the pump fell behind, drop the oldest frames
+	if (in->avail + frames > in->capacity) {
+		size_t drop = in->avail + frames - in->capacity;
+		in->head = (in->head + drop) % in->capacity;
+		in->avail -= drop;
+	}
+
+	size_t tail = (in->head + in->avail) % in->capacity;
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ++ch) {
+		if (in->ring[ch].empty())
+			continue;
+		const float *src =
+			reinterpret_cast<const float *>(audio->data[ch]);
+		float *dst = in->ring[ch].data();
+		for (size_t i = 0; i < frames; ++i)
+			dst[(tail + i) % in->capacity] =
+				src ? src[i] : 0.0f;
+	}
+	in->avail += frames;
+	if (in->avail >= BUS_BLOCK * BUS_PRIME_BLOCKS)
+		in->primed = true;
+}
+
+// ============================================================
+//  Pump
+// ============================================================
+// Adds up to one block of 'in' to 'out'. An input that runs
+// short mid-block contributes what it has, so the rest of its
+// block is silence; it then primes again before the next mix.
+static bool mix_input(bus_input *in, float *const *out,
+		      size_t channels)
+{
+	std::lock_guard<std::mutex> lk(in->mutex);
+	if (!in->primed)
+		return false;
+
+	size_t frames = std::min(in->avail, BUS_BLOCK);
+	for (size_t ch = 0; ch < channels; ++ch) {
+		const float *src = in->ring[ch].data();
+		for (size_t i = 0; i < frames; ++i)
+			out[ch][i] += src[(in->head + i) % in->capacity] *
+				      in->gain;
+	}
+	in->head = (in->head + frames) % in->capacity;
+	in->avail -= frames;
+	if (!in->avail)
+		in->primed = false;
+	return frames > 0;
+}
+
+static uint64_t frames_to_ns(uint64_t frames, uint32_t rate)
+{
+	return frames / rate * 1000000000ULL +
+	       frames % rate * 1000000000ULL / rate;
+}
+
+// The bus runs its own clock: block N is stamped start + N
+// blocks of samples, never with the time the thread woke, so
+// timestamps advance exactly at the sample rate. After an
+// oversleep the missed blocks are mixed back to back until the
+// clock has caught up; a stall of more than BUS_MAX_CATCHUP
+// blocks is skipped, leaving a gap, rather than flushed in one
+// burst.
+//
+// The added delay against an item's own video is the priming
+// (BUS_PRIME_BLOCKS blocks, ~43 ms at 48 kHz) plus up to one
+// block of pump phase, since captured audio is re-timestamped
+// on the bus clock when it is mixed rather than kept on the
+// item's timestamps.
+static void pump_loop(audio_bus *bus)
+{
+	os_set_thread_name("random-media: audio bus");
+
+	std::vector<float> mix[MAX_AUDIO_CHANNELS];
+	float *planes[MAX_AUDIO_CHANNELS] = {};
+	for (size_t ch = 0; ch < bus->channels; ++ch) {
+		mix[ch].resize(BUS_BLOCK);
+		planes[ch] = mix[ch].data();
+	}
+
+	const uint32_t rate = bus->sample_rate;
+	const uint64_t interval = frames_to_ns(BUS_BLOCK, rate);
+	const uint64_t start = os_gettime_ns();
+	uint64_t frames_sent = 0; // silent blocks count too
+
+	while (!bus->stop) {
+		uint64_t ts = start + frames_to_ns(frames_sent, rate);
+		uint64_t due = ts + interval;
+		if (!os_sleepto_ns(due)) {
+			uint64_t behind = (os_gettime_ns() - due) / interval;
+			if (behind > BUS_MAX_CATCHUP) {
+				frames_sent += (behind - BUS_MAX_CATCHUP) *
+					       BUS_BLOCK;
+				continue;
+			}
+		}
+		frames_sent += BUS_BLOCK;
+
+		for (size_t ch = 0; ch < bus->channels; ++ch)
+			std::fill(mix[ch].begin(), mix[ch].end(), 0.0f);
+
+		bool any = false;
+		{
+			std::lock_guard<std::mutex> lk(bus->inputs_mutex);
+			for (bus_input *in : bus->inputs)
+				any |= mix_input(in, planes, bus->channels);
+		}
+		if (!any)
+			continue;
+
+		struct obs_source_audio out = {};
+		for (size_t ch = 0; ch < bus->channels; ++ch)
+			out.data[ch] =
+				reinterpret_cast<const uint8_t *>(planes[ch]);
+		out.frames = (uint32_t)BUS_BLOCK;
+		out.speakers = bus->speakers;
+		out.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		out.samples_per_sec = bus->sample_rate;
+		out.timestamp = ts;
+		obs_source_output_audio(bus->output, &out);
+	}
+}
+
+// ============================================================
+//  Output source type
+// ============================================================
+static const char *bus_get_name(void *)
+{
+	return "Random Media Audio Bus";
+}
+
+static void *bus_source_create(obs_data_t *, obs_source_t *source)
+{
+	return source;
+}
+
+static void bus_source_destroy(void *) {}
+
+void audio_bus_register(void)
+{
+	struct obs_source_info info = {};
+	info.id = BUS_SOURCE_ID;
+	info.type = OBS_SOURCE_TYPE_INPUT;
+	info.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_CAP_DISABLED |
+			    OBS_SOURCE_DO_NOT_DUPLICATE;
+	info.get_name = bus_get_name;
+	info.create = bus_source_create;
+	info.destroy = bus_source_destroy;
+	obs_register_source(&info);
+}
+
+// ============================================================
+//  Public API
+// ============================================================
+audio_bus *audio_bus_create(void)
+{
+	obs_source_t *output = obs_source_create_private(
+		BUS_SOURCE_ID, "RMS_AudioBus", nullptr);
+	if (!output)
+		return nullptr;
+
+	uint32_t channel = 0;
+	for (uint32_t ch = BUS_CHANNEL_FIRST; ch < MAX_CHANNELS; ++ch) {
+		obs_source_t *used = obs_get_output_source(ch);
+		if (!used) {
+			channel = ch;
+			break;
+		}
+		obs_source_release(used);
+	}
+	if (!channel) {
+		blog(LOG_WARNING,
+		     "[RandomMedia] No free output channel for audio bus");
+		obs_source_release(output);
+		return nullptr;
+	}
+
+	auto *bus = new audio_bus();
+	bus->output = output;
+	bus->channel = channel;
+
+	struct obs_audio_info oai = {};
+	if (obs_get_audio_info(&oai)) {
+		bus->sample_rate = oai.samples_per_sec;
+		bus->speakers = oai.speakers;
+	}
+	bus->channels = audio_output_get_channels(obs_get_audio());
+
+	obs_source_set_monitoring_type(
+		output, OBS_MONITORING_TYPE_MONITOR_AND_OUTPUT);
+	obs_set_output_source(channel, output);
+	bus->pump = std::thread(pump_loop, bus);
+
+	blog(LOG_INFO, "[RandomMedia] Audio bus on output channel %u",
+	     channel);
+	return bus;
+}
+
+static void remove_capture(bus_input *in)
+{
+	obs_source_t *src = obs_weak_source_get_source(in->weak);
+	if (src) {
+		obs_source_remove_audio_capture_callback(
+			src, bus_capture_cb, in);
+		obs_source_release(src);
+	}
+	obs_weak_source_release(in->weak);
+	delete in;
+}
+
+void audio_bus_destroy(audio_bus *bus)
+{
+	if (!bus)
+		return;
+	bus->stop = true;
+	if (bus->pump.joinable())
+		bus->pump.join();
+
+	std::vector<bus_input *> inputs;
+	{
+		std::lock_guard<std::mutex> lk(bus->inputs_mutex);
+		inputs.swap(bus->inputs);
+	}
+	for (bus_input *in : inputs)
+		remove_capture(in);
+
+	obs_set_output_source(bus->channel, nullptr);
+	obs_source_release(bus->output);
+	delete bus;
+}
+
+obs_source_t *audio_bus_get_source(audio_bus *bus)
+{
+	return bus ? bus->output : nullptr;
+}
+
+void audio_bus_attach(audio_bus *bus, obs_source_t *media, float gain)
+{
+	auto *in = new bus_input();
+	in->weak = obs_source_get_weak_source(media);
+	in->media = media;
+	in->gain = gain;
+	in->capacity = bus->sample_rate; // one second
+	for (size_t ch = 0; ch < bus->channels; ++ch)
+		in->ring[ch].resize(in->capacity);
+
+	{
+		std::lock_guard<std::mutex> lk(bus->inputs_mutex);
+		bus->inputs.push_back(in);
+	}
+	obs_source_add_audio_capture_callback(media, bus_capture_cb, in);
+}
+
+void audio_bus_detach(audio_bus *bus, obs_source_t *media)
+{
+	bus_input *in = nullptr;
+	{
+		std::lock_guard<std::mutex> lk(bus->inputs_mutex);
+		auto it = std::find_if(bus->inputs.begin(),
+				       bus->inputs.end(),
+				       [media](bus_input *i) {
+					       return i->media == media;
+				       });
+		if (it == bus->inputs.end())
+			return;
+		in = *it;
+		bus->inputs.erase(it);
+	}
+	// Removing the callback waits out any capture in flight
+	remove_capture(in);
+}
@@ -0,0 +1,44 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <obs.h>
+
+// ============================================================
+//  Shared audio bus
+// ============================================================
+// Taps the post-filter audio of attached (muted) media sources,
+// sums it, and re-outputs it through one private audio source
+// placed on a spare output channel. Filters added to that
+// source process the combined mix exactly once.
+struct audio_bus;
+
+// Registers the hidden source type used for bus output
+void audio_bus_register(void);
+
+audio_bus *audio_bus_create(void);
+// Detaches every remaining input and releases the output
+void audio_bus_destroy(audio_bus *bus);
+
+// The bus output source — owned by the bus, no new reference
+obs_source_t *audio_bus_get_source(audio_bus *bus);
+
+// 'gain' is linear and applied while mixing, since capture
+// callbacks see audio before the source's own volume
+void audio_bus_attach(audio_bus *bus, obs_source_t *media, float gain);
+void audio_bus_detach(audio_bus *bus, obs_source_t *media);
@@ -0,0 +1,309 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// ============================================================
+//  File catalog
+// ============================================================
+// Every media path as an interned directory plus a file name.
+// Names live back to back in one string arena and directories
+// are stored once each, so a catalog of millions of files is a
+// couple of allocations, not one per path. Entries are 16
+// bytes; full paths are only built when asked for.
+//
+// Membership tests go through a path index, built by the first
+// lookup and kept up to date by later adds — a scan never pays
+// for it, a watched library only once.
+//
+// Not thread-safe, lookups included: published through
+// rcu_snapshot like the plain list it replaces, and edited
+// copy-on-write.
+class file_catalog {
+public:
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+	size_t dir_count() const { return dirs.size(); }
+	size_t arena_bytes() const { return arena.size(); }
+
+	void reserve(size_t files, size_t bytes)
+	{
+		entries.reserve(files);
+		arena.reserve(bytes);
+	}
+
+	// ID of 'dir', added if new
+	uint32_t intern_dir(std::string_view dir)
+	{
+		auto it = dir_ids.find(std::string(dir));
+		if (it != dir_ids.end())
+			return it->second;
+		uint32_t id = (uint32_t)dirs.size();
+		dirs.push_back({append(dir), (uint32_t)dir.size()});
+		dir_ids.emplace(std::string(dir), id);
+		return id;
+	}
+
+	void add(uint32_t dir, std::string_view name)
+	{
+		entries.push_back({dir, (uint32_t)name.size(),
+				   append(name)});
+		if (!index.empty())
+			index_insert((uint32_t)entries.size() - 1);
+	}
+
+	void add(std::string_view dir, std::string_view name)
+	{
+		add(intern_dir(dir), name);
+	}
+
+	// Splits at the last separator; a bare name goes under ""
+	void add_path(std::string_view path)
+	{
+		size_t sep = path.find_last_of("/\\");
+		if (sep == std::string_view::npos)
+			add(std::string_view(), path);
+		else
+			add(path.substr(0, sep), path.substr(sep + 1));
+	}
+
+	std::string_view dir(size_t i) const
+	{
+		const dir_ref &d = dirs[entries[i].dir];
+		return std::string_view(arena).substr(d.off, d.len);
+	}
+
+	std::string_view name(size_t i) const
+	{
+		const entry &e = entries[i];
+		return std::string_view(arena).substr(e.off, e.len);
+	}
+
+	uint32_t dir_id(size_t i) const { return entries[i].dir; }
+
+	std::string_view dir_by_id(uint32_t id) const
+	{
+		return std::string_view(arena).substr(dirs[id].off,
+						      dirs[id].len);
+	}
+
+	// Builds the full path in one allocation
+	std::string path(size_t i) const
+	{
+		std::string_view d = dir(i), n = name(i);
+		std::string out;
+		out.reserve(d.size() + 1 + n.size());
+		if (!d.empty()) {
+			out.append(d);
+			out.push_back('/');
+		}
+		out.append(n);
+		return out;
+	}
+
+	bool contains(std::string_view path)
+	{
+		std::string_view d, n;
+		split(path, d, n);
+		auto it = dir_ids.find(std::string(d));
+		if (it == dir_ids.end())
+			return false;
+		if (index.empty())
+			index_build();
+		size_t mask = index.size() - 1;
+		for (size_t h = hash(it->second, n) & mask;;
+		     h = (h + 1) & mask) {
+			uint32_t slot = index[h];
+			if (!slot)
+				return false;
+			const entry &e = entries[slot - 1];
+			if (e.dir == it->second && name(slot - 1) == n)
+				return true;
+		}
+	}
+
+	// Drops each of 'paths' and, for directories, everything
+	// under them, in one pass. Returns the number of entries
+	// removed.
+	size_t remove_under(const std::vector<std::string> &paths)
+	{
+		if (paths.empty() || entries.empty())
+			return 0;
+		std::unordered_set<std::string_view> gone(paths.begin(),
+							  paths.end());
+		// Directories are few, so each is checked once, with
+		// its ancestors
+		std::vector<char> dir_gone(dirs.size(), 0);
+		for (uint32_t id = 0; id < dirs.size(); ++id) {
+			std::string_view d = dir_by_id(id);
+			for (;;) {
+				if (gone.count(d)) {
+					dir_gone[id] = 1;
+					break;
+				}
+				size_t sep = d.find_last_of('/');
+				if (sep == std::string_view::npos)
+					break;
+				d = d.substr(0, sep);
+			}
+		}
+		// Single files, by directory
+		std::unordered_map<uint32_t, std::vector<std::string_view>>
+			files;
+		for (const std::string &p : paths) {
+			std::string_view d, n;
+			split(p, d, n);
+			auto it = dir_ids.find(std::string(d));
+			if (it != dir_ids.end())
+				files[it->second].push_back(n);
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			const entry &e = entries[i];
+			bool under = dir_gone[e.dir] != 0;
+			if (!under) {
+				auto it = files.find(e.dir);
+				if (it != files.end())
+					for (std::string_view n : it->second)
+						under |= name(i) == n;
+			}
+			if (under)
+				garbage += e.len;
+			else
+				entries[kept++] = e;
+		}
+		size_t removed = entries.size() - kept;
+		entries.resize(kept);
+		if (removed)
+			index.clear(); // positions moved; rebuilt lazily
+		if (garbage > arena.size() / 2)
+			compact();
+		return removed;
+	}
+
+	size_t remove_under(std::string_view path)
+	{
+		return remove_under(
+			std::vector<std::string>{std::string(path)});
+	}
+
+private:
+	struct entry {
+		uint32_t dir;
+		uint32_t len;
+		uint64_t off; // into 'arena'
+	};
+	struct dir_ref {
+		uint64_t off;
+		uint32_t len;
+	};
+
+	uint64_t append(std::string_view s)
+	{
+		uint64_t off = arena.size();
+		arena.append(s);
+		return off;
+	}
+
+	// As add_path splits
+	static void split(std::string_view path, std::string_view &d,
+			  std::string_view &n)
+	{
+		size_t sep = path.find_last_of("/\\");
+		if (sep == std::string_view::npos) {
+			d = std::string_view();
+			n = path;
+		} else {
+			d = path.substr(0, sep);
+			n = path.substr(sep + 1);
+		}
+	}
+
+	// FNV-1a over the name, seeded with the directory
+	static size_t hash(uint32_t dir, std::string_view name)
+	{
+		uint64_t h = 14695981039346656037ULL ^ dir;
+		for (unsigned char c : name) {
+			h ^= c;
+			h *= 1099511628211ULL;
+		}
+		return (size_t)h;
+	}
+
+	// Linear probing over entry positions + 1, at most half
+	// full; 0 is an empty slot
+	void index_build()
+	{
+		size_t cap = 16;
+		while (cap < entries.size() * 2 + 2)
+			cap *= 2;
+		index.assign(cap, 0);
+		index_used = 0;
+		for (uint32_t i = 0; i < entries.size(); ++i)
+			index_insert(i);
+	}
+
+	void index_insert(uint32_t i)
+	{
+		if ((index_used + 1) * 2 > index.size()) {
+			index_build(); // includes 'i', already added
+			return;
+		}
+		size_t mask = index.size() - 1;
+		size_t h = hash(entries[i].dir, name(i)) & mask;
+		while (index[h])
+			h = (h + 1) & mask;
+		index[h] = i + 1;
+		index_used++;
+	}
+
+	// Rebuilds the arena without the names of removed entries;
+	// directories are kept, they are few
+	void compact()
+	{
+		std::string next;
+		next.reserve(arena.size() - garbage);
+		for (dir_ref &d : dirs) {
+			uint64_t off = next.size();
+			next.append(arena, d.off, d.len);
+			d.off = off;
+		}
+		for (entry &e : entries) {
+			uint64_t off = next.size();
+			next.append(arena, e.off, e.len);
+			e.off = off;
+		}
+		arena.swap(next);
+		garbage = 0;
+	}
+
+	std::string arena;
+	std::vector<entry> entries;
+	std::vector<dir_ref> dirs;
+	std::unordered_map<std::string, uint32_t> dir_ids;
+	size_t garbage = 0; // arena bytes of removed names
+	std::vector<uint32_t> index; // empty until a lookup
+	size_t index_used = 0;
+};
@@ -0,0 +1,491 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "folder-watcher.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <unordered_map>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <vector>
+#elif defined(__APPLE__)
+#include <CoreServices/CoreServices.h>
+#include <stdlib.h>
+#endif
+
+#if defined(__linux__)
+// ============================================================
+//  Linux — inotify
+// ============================================================
+struct folder_watcher {
+	std::string root;
+	bool recursive;
+	folder_event_cb cb;
+	int fd = -1;
+	int stop_pipe[2] = {-1, -1};
+	std::unordered_map<int, std::string> dirs;
+	std::thread thread;
+};
+
+static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_FROM |
+				       IN_MOVED_TO | IN_DELETE |
+				       IN_CREATE | IN_DELETE_SELF;
+
+static void add_watch(folder_watcher *w, const std::string &dir)
+{
+	int wd = inotify_add_watch(w->fd, dir.c_str(), WATCH_MASK);
+	if (wd < 0) {
+		blog(LOG_WARNING, "[RandomMedia] Cannot watch: %s",
+		     dir.c_str());
+		return;
+	}
+	w->dirs[wd] = dir;
+	if (!w->recursive)
+		return;
+
+	os_dir_t *d = os_opendir(dir.c_str());
+	if (!d)
+		return;
+	struct os_dirent *ent;
+	while ((ent = os_readdir(d))) {
+		if (!ent->directory || strcmp(ent->d_name, ".") == 0 ||
+		    strcmp(ent->d_name, "..") == 0)
+			continue;
+		add_watch(w, dir + "/" + ent->d_name);
+	}
+	os_closedir(d);
+}
+
+// Drops watches on a directory that was moved out of the tree
+static void remove_watches(folder_watcher *w, const std::string &dir)
+{
+	std::string prefix = dir + "/";
+	for (auto it = w->dirs.begin(); it != w->dirs.end();) {
+		if (it->second == dir ||
+		    it->second.compare(0, prefix.size(), prefix) == 0) {
+			inotify_rm_watch(w->fd, it->first);
+			it = w->dirs.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+static void handle_event(folder_watcher *w,
+			 const struct inotify_event *ev,
+			 std::vector<folder_event> &out)
+{
+	if (ev->mask & IN_Q_OVERFLOW) {
+		out.push_back({folder_event_type::rescan, w->root});
+		return;
+	}
+	if (ev->mask & IN_IGNORED) {
+		w->dirs.erase(ev->wd);
+		return;
+	}
+
+	auto it = w->dirs.find(ev->wd);
+	if (it == w->dirs.end() || !ev->len)
+		return;
+	std::string path = it->second + "/" + ev->name;
+	bool is_dir = (ev->mask & IN_ISDIR) != 0;
+
+	if (is_dir) {
+		if (!w->recursive)
+			return;
+		if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+			add_watch(w, path);
+			out.push_back({folder_event_type::added, path, true});
+		} else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+			remove_watches(w, path);
+			out.push_back(
+				{folder_event_type::removed, path, true});
+		}
+		return;
+	}
+
+	// IN_CREATE fires before the data is written, so files are
+	// only reported once closed or moved in
+	if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+		out.push_back({folder_event_type::added, path});
+	else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+		out.push_back({folder_event_type::removed, path});
+}
+
+static void watcher_loop(folder_watcher *w)
+{
+	os_set_thread_name("random-media: watcher");
+
+	alignas(struct inotify_event) char buf[16384];
+	struct pollfd fds[2] = {{w->fd, POLLIN, 0},
+				{w->stop_pipe[0], POLLIN, 0}};
+	for (;;) {
+		if (poll(fds, 2, -1) < 0)
+			continue;
+		if (fds[1].revents)
+			break;
+		ssize_t len = read(w->fd, buf, sizeof(buf));
+		if (len <= 0)
+			continue;
+		std::vector<folder_event> batch;
+		for (char *p = buf; p < buf + len;) {
+			auto *ev = reinterpret_cast<struct inotify_event *>(p);
+			handle_event(w, ev, batch);
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+		if (!batch.empty())
+			w->cb(batch);
+	}
+}
+
+folder_watcher *folder_watcher_create(const std::string &root,
+				      bool recursive,
+				      folder_event_cb cb)
+{
+	auto *w = new folder_watcher();
+	w->root = root;
+	w->recursive = recursive;
+	w->cb = std::move(cb);
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->fd < 0 || pipe(w->stop_pipe) != 0) {
+		if (w->fd >= 0)
+			close(w->fd);
+		delete w;
+		return nullptr;
+	}
+
+	add_watch(w, root);
+	if (w->dirs.empty()) {
+		close(w->fd);
+		close(w->stop_pipe[0]);
+		close(w->stop_pipe[1]);
+		delete w;
+		return nullptr;
+	}
+	w->thread = std::thread(watcher_loop, w);
+	return w;
+}
+
+void folder_watcher_destroy(folder_watcher *w)
+{
+	if (!w)
+		return;
+	char c = 0;
+	if (write(w->stop_pipe[1], &c, 1) != 1)
+		blog(LOG_WARNING, "[RandomMedia] Watcher stop failed");
+	w->thread.join();
+	close(w->fd);
+	close(w->stop_pipe[0]);
+	close(w->stop_pipe[1]);
+	delete w;
+}
+
+#elif defined(_WIN32)
+// ============================================================
+//  Windows — ReadDirectoryChangesW
+// ============================================================
+struct folder_watcher {
+	std::string root;
+	bool recursive;
+	folder_event_cb cb;
+	HANDLE dir = INVALID_HANDLE_VALUE;
+	HANDLE stop_event = nullptr;
+	std::thread thread;
+};
+
+static std::string to_utf8_path(const wchar_t *name, size_t len)
+{
+	std::wstring wide(name, len);
+	char *utf8 = nullptr;
+	os_wcs_to_utf8_ptr(wide.c_str(), wide.size(), &utf8);
+	std::string out = utf8 ? utf8 : "";
+	bfree(utf8);
+	for (char &c : out)
+		if (c == '\\')
+			c = '/';
+	return out;
+}
+
+static bool path_is_dir(const std::string &path)
+{
+	wchar_t *wpath = nullptr;
+	os_utf8_to_wcs_ptr(path.c_str(), path.size(), &wpath);
+	DWORD attr = wpath ? GetFileAttributesW(wpath)
+			   : INVALID_FILE_ATTRIBUTES;
+	bfree(wpath);
+	return attr != INVALID_FILE_ATTRIBUTES &&
+	       (attr & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+static void watcher_loop(folder_watcher *w)
+{
+	os_set_thread_name("random-media: watcher");
+
+	std::vector<DWORD> buf(16384);
+	OVERLAPPED ov = {};
+	ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	HANDLE handles[2] = {ov.hEvent, w->stop_event};
+
+	for (;;) {
+		ResetEvent(ov.hEvent);
+		BOOL ok = ReadDirectoryChangesW(
+			w->dir, buf.data(),
+			(DWORD)(buf.size() * sizeof(DWORD)), w->recursive,
+			FILE_NOTIFY_CHANGE_FILE_NAME |
+				FILE_NOTIFY_CHANGE_DIR_NAME |
+				FILE_NOTIFY_CHANGE_LAST_WRITE,
+			nullptr, &ov, nullptr);
+		if (!ok) {
+			w->cb({{folder_event_type::rescan, w->root}});
+			break;
+		}
+
+		DWORD res = WaitForMultipleObjects(2, handles, FALSE,
+						   INFINITE);
+		if (res != WAIT_OBJECT_0) {
+			CancelIo(w->dir);
+			DWORD dummy;
+			GetOverlappedResult(w->dir, &ov, &dummy, TRUE);
+			break;
+		}
+
+		DWORD bytes = 0;
+		if (!GetOverlappedResult(w->dir, &ov, &bytes, FALSE) ||
+		    bytes == 0) {
+			// Buffer overflowed — the OS dropped events
+			w->cb({{folder_event_type::rescan, w->root}});
+			continue;
+		}
+
+		std::vector<folder_event> batch;
+		auto *p = reinterpret_cast<uint8_t *>(buf.data());
+		for (;;) {
+			auto *fni =
+				reinterpret_cast<FILE_NOTIFY_INFORMATION *>(p);
+			std::string path =
+				w->root + "/" +
+				to_utf8_path(fni->FileName,
+					     fni->FileNameLength /
+						     sizeof(wchar_t));
+			switch (fni->Action) {
+			case FILE_ACTION_ADDED:
+			case FILE_ACTION_RENAMED_NEW_NAME:
+			case FILE_ACTION_MODIFIED: {
+				bool is_dir = path_is_dir(path);
+				// New subfolders are outside a flat
+				// library, as on the other backends
+				if (is_dir && !w->recursive)
+					break;
+				if (!is_dir || fni->Action !=
+						       FILE_ACTION_MODIFIED)
+					batch.push_back(
+						{folder_event_type::added,
+						 path, is_dir});
+				break;
+			}
+			case FILE_ACTION_REMOVED:
+			case FILE_ACTION_RENAMED_OLD_NAME:
+				batch.push_back(
+					{folder_event_type::removed, path});
+				break;
+			}
+			if (!fni->NextEntryOffset)
+				break;
+			p += fni->NextEntryOffset;
+		}
+		if (!batch.empty())
+			w->cb(batch);
+	}
+	CloseHandle(ov.hEvent);
+}
+
+folder_watcher *folder_watcher_create(const std::string &root,
+				      bool recursive,
+				      folder_event_cb cb)
+{
+	wchar_t *wroot = nullptr;
+	os_utf8_to_wcs_ptr(root.c_str(), root.size(), &wroot);
+	if (!wroot)
+		return nullptr;
+	HANDLE dir = CreateFileW(
+		wroot, FILE_LIST_DIRECTORY,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		nullptr);
+	bfree(wroot);
+	if (dir == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	auto *w = new folder_watcher();
+	w->root = root;
+	w->recursive = recursive;
+	w->cb = std::move(cb);
+	w->dir = dir;
+	w->stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	w->thread = std::thread(watcher_loop, w);
+	return w;
+}
+
+void folder_watcher_destroy(folder_watcher *w)
+{
+	if (!w)
+		return;
+	SetEvent(w->stop_event);
+	if (w->thread.joinable())
+		w->thread.join();
+	CloseHandle(w->stop_event);
+	CloseHandle(w->dir);
+	delete w;
+}
+
+#elif defined(__APPLE__)
+// ============================================================
+//  macOS — FSEvents
+// ============================================================
+struct folder_watcher {
+	std::string root;
+	std::string real_root; // FSEvents reports resolved paths
+	bool recursive;
+	folder_event_cb cb;
+	FSEventStreamRef stream = nullptr;
+	dispatch_queue_t queue = nullptr;
+};
+
+static constexpr FSEventStreamEventFlags DROPPED_FLAGS =
+	kFSEventStreamEventFlagMustScanSubDirs |
+	kFSEventStreamEventFlagUserDropped |
+	kFSEventStreamEventFlagKernelDropped;
+
+static void fsevents_cb(ConstFSEventStreamRef, void *info, size_t count,
+			void *event_paths,
+			const FSEventStreamEventFlags flags[],
+			const FSEventStreamEventId[])
+{
+	auto *w = static_cast<folder_watcher *>(info);
+	char **paths = static_cast<char **>(event_paths);
+
+	std::vector<folder_event> batch;
+	for (size_t i = 0; i < count; ++i) {
+		if (flags[i] & DROPPED_FLAGS) {
+			batch.push_back({folder_event_type::rescan, w->root});
+			continue;
+		}
+		std::string p = paths[i];
+		if (p.compare(0, w->real_root.size(), w->real_root) != 0)
+			continue;
+		std::string path = w->root + p.substr(w->real_root.size());
+
+		// FSEvents always watches the whole tree
+		size_t slash = path.find_last_of('/');
+		if (!w->recursive && path.substr(0, slash) != w->root)
+			continue;
+
+		bool is_dir = (flags[i] &
+			       kFSEventStreamEventFlagItemIsDir) != 0;
+		if (is_dir && !w->recursive)
+			continue;
+
+		// Create/rename/remove flags are coalesced, so the
+		// final state on disk decides
+		if (os_file_exists(path.c_str()))
+			batch.push_back(
+				{folder_event_type::added, path, is_dir});
+		else
+			batch.push_back(
+				{folder_event_type::removed, path, is_dir});
+	}
+	if (!batch.empty())
+		w->cb(batch);
+}
+
+folder_watcher *folder_watcher_create(const std::string &root,
+				      bool recursive,
+				      folder_event_cb cb)
+{
+	char *real = realpath(root.c_str(), nullptr);
+	if (!real)
+		return nullptr;
+
+	auto *w = new folder_watcher();
+	w->root = root;
+	w->real_root = real;
+	w->recursive = recursive;
+	w->cb = std::move(cb);
+	free(real);
+
+	CFStringRef cfroot = CFStringCreateWithCString(
+		nullptr, w->real_root.c_str(), kCFStringEncodingUTF8);
+	CFArrayRef paths = CFArrayCreate(
+		nullptr, (const void **)&cfroot, 1, &kCFTypeArrayCallBacks);
+	FSEventStreamContext ctx = {0, w, nullptr, nullptr, nullptr};
+	w->stream = FSEventStreamCreate(
+		nullptr, fsevents_cb, &ctx, paths,
+		kFSEventStreamEventIdSinceNow, 0.2,
+		kFSEventStreamCreateFlagFileEvents |
+			kFSEventStreamCreateFlagNoDefer);
+	CFRelease(paths);
+	CFRelease(cfroot);
+	if (!w->stream) {
+		delete w;
+		return nullptr;
+	}
+
+	w->queue = dispatch_queue_create("random-media.watcher",
+					 DISPATCH_QUEUE_SERIAL);
+	FSEventStreamSetDispatchQueue(w->stream, w->queue);
+	if (!FSEventStreamStart(w->stream)) {
+		FSEventStreamInvalidate(w->stream);
+		FSEventStreamRelease(w->stream);
+		dispatch_release(w->queue);
+		delete w;
+		return nullptr;
+	}
+	return w;
+}
+
+void folder_watcher_destroy(folder_watcher *w)
+{
+	if (!w)
+		return;
+	FSEventStreamStop(w->stream);
+	FSEventStreamInvalidate(w->stream);
+	FSEventStreamRelease(w->stream);
+	// Drain callbacks that were already dispatched
+	dispatch_sync_f(w->queue, nullptr, [](void *) {});
+	dispatch_release(w->queue);
+	delete w;
+}
+
+#else
+folder_watcher *folder_watcher_create(const std::string &, bool,
+				      folder_event_cb)
+{
+	return nullptr;
+}
+
+void folder_watcher_destroy(folder_watcher *) {}
+#endif
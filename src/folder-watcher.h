@@ -0,0 +1,57 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// ============================================================
+//  Folder watcher
+// ============================================================
+// Thin wrapper over the OS change-notification API (inotify,
+// ReadDirectoryChangesW, FSEvents). Events are delivered on a
+// watcher-owned thread, with '/' separated absolute paths that
+// start with the root passed to folder_watcher_create(), in
+// order and in batches — everything one read from the OS
+// returned — so a burst can be applied at once.
+enum class folder_event_type {
+	added,   // file written/moved in, or a new directory
+	removed, // file or directory deleted/moved out
+	rescan,  // events were dropped — do a full rescan
+};
+
+struct folder_event {
+	folder_event_type type;
+	std::string path;
+	bool is_dir = false; // only reliable for 'added'
+};
+
+typedef std::function<void(const std::vector<folder_event> &)>
+	folder_event_cb;
+
+struct folder_watcher;
+
+// Returns nullptr if the platform has no watcher or the folder
+// cannot be watched; callers then rely on explicit rescans
+folder_watcher *folder_watcher_create(const std::string &root,
+				      bool recursive,
+				      folder_event_cb cb);
+// Blocks until the watcher thread has stopped; no callback runs
+// after this returns
+void folder_watcher_destroy(folder_watcher *w);
@@ -0,0 +1,265 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "image-source.h"
+
+#include <obs-module.h>
+#include <graphics/image-file.h>
+#include <util/platform.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// ============================================================
+//  Texture cache
+// ============================================================
+struct cached_image {
+	std::string path;
+	int64_t mtime = 0;
+	gs_image_file_t image = {};
+	int refs = 0;
+	bool loading = true; // decode or upload still running
+};
+
+// 'loading' entries are listed before they are decoded, so a
+// second request for the same file waits on s_cache_cv instead
+// of decoding it again. The mutex itself is never held across
+// a decode or upload: cache_release takes it from the video
+// tick.
+static std::mutex s_cache_mutex;
+static std::condition_variable s_cache_cv;
+static std::unordered_map<std::string, cached_image *> s_cache;
+
+static int64_t file_mtime(const char *path)
+{
+	struct stat st = {};
+	return os_stat(path, &st) == 0 ? (int64_t)st.st_mtime : 0;
+}
+
+static void cache_release(cached_image *img)
+{
+	if (!img)
+		return;
+	{
+		std::lock_guard<std::mutex> lk(s_cache_mutex);
+		if (--img->refs > 0)
+			return;
+		auto it = s_cache.find(img->path);
+		if (it != s_cache.end() && it->second == img)
+			s_cache.erase(it);
+	}
+	obs_enter_graphics();
+	gs_image_file_free(&img->image);
+	obs_leave_graphics();
+	delete img;
+}
+
+// Decodes on the calling thread; only the texture upload needs
+// the graphics context. A file changed on disk gets a fresh
+// entry while holders of the old one keep theirs.
+static cached_image *cache_acquire(const std::string &path)
+{
+	int64_t mtime = file_mtime(path.c_str());
+
+	std::unique_lock<std::mutex> lk(s_cache_mutex);
+	auto it = s_cache.find(path);
+	if (it != s_cache.end()) {
+		cached_image *img = it->second;
+		if (img->mtime == mtime) {
+			img->refs++;
+			s_cache_cv.wait(lk, [img] { return !img->loading; });
+			if (img->image.loaded)
+				return img;
+			lk.unlock();
+			cache_release(img);
+			return nullptr;
+		}
+		// Unlisted; freed by its last release
+		s_cache.erase(it);
+	}
+
+	auto *img = new cached_image();
+	img->path = path;
+	img->mtime = mtime;
+	img->refs = 1;
+	s_cache.emplace(path, img);
+	lk.unlock();
+
+	gs_image_file_init(&img->image, path.c_str());
+	bool ok = img->image.loaded;
+	if (ok) {
+		obs_enter_graphics();
+		gs_image_file_init_texture(&img->image);
+		obs_leave_graphics();
+	} else {
+		blog(LOG_WARNING, "[RandomMedia] Failed to load image: %s",
+		     path.c_str());
+	}
+
+	lk.lock();
+	img->loading = false;
+	if (!ok) {
+		it = s_cache.find(path);
+		if (it != s_cache.end() && it->second == img)
+			s_cache.erase(it);
+	}
+	lk.unlock();
+	s_cache_cv.notify_all();
+
+	if (!ok) {
+		// Waiters drop their references the same way
+		cache_release(img);
+		return nullptr;
+	}
+	return img;
+}
+
+// ============================================================
+//  Source
+// ============================================================
+struct image_source {
+	obs_source_t *source = nullptr;
+	std::string file;
+	std::atomic<cached_image *> image{nullptr};
+	float duration = 0.0f;
+
+	// Render thread only
+	float elapsed = 0.0f;
+	bool started = false;
+	bool ended = false;
+	std::atomic<bool> restart{false};
+};
+
+static const char *image_get_name(void *)
+{
+	return "Random Media Image";
+}
+
+static void image_update(void *d, obs_data_t *settings)
+{
+	auto *s = static_cast<image_source *>(d);
+	s->duration = (float)obs_data_get_double(settings, "duration");
+
+	std::string file = obs_data_get_string(settings, "file");
+	if (file == s->file)
+		return;
+	s->file = file;
+
+	cached_image *next = file.empty() ? nullptr
+					  : cache_acquire(file);
+	// Rendering holds the graphics context, which the release
+	// takes before freeing, so the old texture is not in use
+	cache_release(s->image.exchange(next));
+}
+
+static void *image_create(obs_data_t *settings, obs_source_t *source)
+{
+	auto *s = new image_source();
+	s->source = source;
+	image_update(s, settings);
+	return s;
+}
+
+static void image_destroy(void *d)
+{
+	auto *s = static_cast<image_source *>(d);
+	cache_release(s->image.exchange(nullptr));
+	delete s;
+}
+
+static void image_activate(void *d)
+{
+	static_cast<image_source *>(d)->restart = true;
+}
+
+static uint32_t image_get_width(void *d)
+{
+	cached_image *img = static_cast<image_source *>(d)->image;
+	return img ? img->image.cx : 0;
+}
+
+static uint32_t image_get_height(void *d)
+{
+	cached_image *img = static_cast<image_source *>(d)->image;
+	return img ? img->image.cy : 0;
+}
+
+static void image_tick(void *d, float seconds)
+{
+	auto *s = static_cast<image_source *>(d);
+	if (s->restart.exchange(false)) {
+		s->elapsed = 0.0f;
+		s->started = false;
+		s->ended = false;
+	}
+	if (!obs_source_active(s->source) || s->ended || !s->image)
+		return;
+
+	if (!s->started) {
+		s->started = true;
+		obs_source_media_started(s->source);
+		return;
+	}
+	s->elapsed += seconds;
+	if (s->duration > 0.0f && s->elapsed >= s->duration) {
+		s->ended = true;
+		obs_source_media_ended(s->source);
+	}
+}
+
+static void image_render(void *d, gs_effect_t *effect)
+{
+	cached_image *img = static_cast<image_source *>(d)->image;
+	if (!img || !img->image.texture)
+		return;
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(true);
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	gs_eparam_t *param = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture_srgb(param, img->image.texture);
+	gs_draw_sprite(img->image.texture, 0, img->image.cx,
+		       img->image.cy);
+
+	gs_blend_state_pop();
+	gs_enable_framebuffer_srgb(previous);
+}
+
+void image_source_register(void)
+{
+	struct obs_source_info info = {};
+	info.id = IMAGE_SOURCE_ID;
+	info.type = OBS_SOURCE_TYPE_INPUT;
+	info.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			    OBS_SOURCE_CAP_DISABLED |
+			    OBS_SOURCE_DO_NOT_DUPLICATE;
+	info.get_name = image_get_name;
+	info.create = image_create;
+	info.destroy = image_destroy;
+	info.update = image_update;
+	info.activate = image_activate;
+	info.get_width = image_get_width;
+	info.get_height = image_get_height;
+	info.video_tick = image_tick;
+	info.video_render = image_render;
+	obs_register_source(&info);
+}
@@ -0,0 +1,33 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+// ============================================================
+//  Still image source
+// ============================================================
+// Hidden source type for still images. Decoded images are kept
+// in a ref-counted texture cache keyed by path, so repeated
+// spawns of one file share a single GPU texture. The source
+// emits media_started on its first tick after activation and
+// media_ended once 'duration' seconds have elapsed (0 = never),
+// so it plugs into the same hide-on-end path as ffmpeg_source.
+//
+// Settings: "file" (string), "duration" (double, seconds)
+#define IMAGE_SOURCE_ID "random_media_image"
+
+void image_source_register(void);
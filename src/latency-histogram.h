@@ -0,0 +1,89 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+// ============================================================
+//  Latency histogram
+// ============================================================
+// Lock-free log-linear histogram of durations in microseconds:
+// exact below 8 us, then 8 sub-buckets per power of two, which
+// bounds the error of any percentile to 12.5%. record() is a
+// single relaxed increment, so it is safe on any hot path.
+struct latency_histogram {
+	static constexpr int SUB_BITS = 3;
+	static constexpr int SUB = 1 << SUB_BITS;
+	static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+	std::atomic<uint64_t> counts[BUCKETS]{};
+	std::atomic<uint64_t> total{0};
+
+	static int bucket_of(uint64_t us)
+	{
+		if (us < (uint64_t)SUB)
+			return (int)us;
+		int msb = (int)std::bit_width(us) - 1;
+		int shift = msb - SUB_BITS;
+		return (msb - SUB_BITS + 1) * SUB +
+		       (int)((us >> shift) & (SUB - 1));
+	}
+
+	// Midpoint of a bucket, in microseconds
+	static double bucket_value(int idx)
+	{
+		if (idx < SUB)
+			return (double)idx;
+		int msb = idx / SUB + SUB_BITS - 1;
+		int sub = idx % SUB;
+		double lo = (double)((uint64_t)(SUB + sub)
+				     << (msb - SUB_BITS));
+		double width = (double)(1ULL << (msb - SUB_BITS));
+		return lo + width / 2.0;
+	}
+
+	void record(uint64_t ns)
+	{
+		counts[bucket_of(ns / 1000)].fetch_add(
+			1, std::memory_order_relaxed);
+		total.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t count() const
+	{
+		return total.load(std::memory_order_relaxed);
+	}
+
+	// 'p' in [0, 1]; returns milliseconds, 0 when empty
+	double percentile_ms(double p) const
+	{
+		uint64_t n = count();
+		if (!n)
+			return 0.0;
+		uint64_t rank = (uint64_t)(p * (double)(n - 1)) + 1;
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; ++i) {
+			seen += counts[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+				return bucket_value(i) / 1000.0;
+		}
+		return bucket_value(BUCKETS - 1) / 1000.0;
+	}
+};
@@ -0,0 +1,220 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// ============================================================
+//  Loudness meter
+// ============================================================
+// EBU R128 / ITU-R BS.1770-4 integrated loudness and true peak
+// of a whole file. Samples are K-weighted (shelf + high-pass
+// biquads), summed over 400 ms blocks every 100 ms, gated at
+// -70 LUFS and then 10 LU below the ungated mean. True peak is
+// the largest magnitude after 4x windowed-sinc oversampling.
+//
+// Meant for offline analysis: feed one frame (one sample per
+// channel) at a time, then read the results.
+class loudness_meter {
+public:
+	static constexpr uint32_t METER_CHANNELS = 8;
+
+	loudness_meter(uint32_t sample_rate, uint32_t channels)
+		: rate(sample_rate),
+		  chans(std::min(channels, METER_CHANNELS)),
+		  sub_len(std::max(1u, sample_rate / 10))
+	{
+		init_filter();
+		init_oversampler();
+		// 5.1: LFE is ignored, surrounds weigh +1.5 dB
+		for (uint32_t c = 0; c < METER_CHANNELS; ++c)
+			weight[c] = 1.0;
+		if (chans == 6) {
+			weight[3] = 0.0;
+			weight[4] = weight[5] = 1.41;
+		}
+	}
+
+	void add_frame(const float *samples)
+	{
+		for (uint32_t c = 0; c < chans; ++c) {
+			double x = samples[c];
+			track_peak(c, x);
+
+			channel_state &s = state[c];
+			double y = pb[0] * x + s.z1[0];
+			s.z1[0] = pb[1] * x - pa[1] * y + s.z1[1];
+			s.z1[1] = pb[2] * x - pa[2] * y;
+			double z = rb[0] * y + s.z2[0];
+			s.z2[0] = rb[1] * y - ra[1] * z + s.z2[1];
+			s.z2[1] = rb[2] * y - ra[2] * z;
+			sub_sum += weight[c] * z * z;
+		}
+		if (++sub_pos < sub_len)
+			return;
+
+		// One 100 ms step done; a block is the last four
+		sub[sub_count++ % 4] = sub_sum / sub_len;
+		sub_sum = 0.0;
+		sub_pos = 0;
+		if (sub_count >= 4)
+			blocks.push_back((sub[0] + sub[1] + sub[2] +
+					  sub[3]) /
+					 4.0);
+	}
+
+	// false when there was no block above the absolute gate,
+	// i.e. the audio is silent or shorter than 400 ms
+	bool integrated(double &lufs) const
+	{
+		const double abs_gate = energy_of(-70.0);
+		double sum = 0.0;
+		size_t n = 0;
+		for (double e : blocks)
+			if (e > abs_gate) {
+				sum += e;
+				n++;
+			}
+		if (!n)
+			return false;
+
+		double rel_gate = energy_of(loudness_of(sum / n) - 10.0);
+		double gated = 0.0;
+		size_t m = 0;
+		for (double e : blocks)
+			if (e > abs_gate && e > rel_gate) {
+				gated += e;
+				m++;
+			}
+		lufs = loudness_of(m ? gated / m : sum / n);
+		return true;
+	}
+
+	// dBTP; -inf for digital silence
+	double true_peak_db() const
+	{
+		return peak > 0.0 ? 20.0 * std::log10(peak) : -INFINITY;
+	}
+
+	uint64_t frames() const
+	{
+		return (uint64_t)sub_count * sub_len + sub_pos;
+	}
+
+private:
+	static constexpr int TAPS = 12;
+	static constexpr int PHASES = 4;
+
+	struct channel_state {
+		double z1[2] = {0.0, 0.0};
+		double z2[2] = {0.0, 0.0};
+		double hist[TAPS] = {};
+		int pos = 0;
+	};
+
+	static double loudness_of(double energy)
+	{
+		return -0.691 + 10.0 * std::log10(energy);
+	}
+
+	static double energy_of(double lufs)
+	{
+		return std::pow(10.0, (lufs + 0.691) / 10.0);
+	}
+
+	// Coefficients as in BS.1770, re-derived for any rate
+	void init_filter()
+	{
+		const double pi = 3.14159265358979323846;
+		double f0 = 1681.974450955533;
+		double g = 3.999843853973347;
+		double q = 0.7071752369554196;
+		double k = std::tan(pi * f0 / rate);
+		double vh = std::pow(10.0, g / 20.0);
+		double vb = std::pow(vh, 0.4996667741545416);
+		double a0 = 1.0 + k / q + k * k;
+		pb[0] = (vh + vb * k / q + k * k) / a0;
+		pb[1] = 2.0 * (k * k - vh) / a0;
+		pb[2] = (vh - vb * k / q + k * k) / a0;
+		pa[1] = 2.0 * (k * k - 1.0) / a0;
+		pa[2] = (1.0 - k / q + k * k) / a0;
+
+		f0 = 38.13547087602444;
+		q = 0.5003270373238773;
+		k = std::tan(pi * f0 / rate);
+		a0 = 1.0 + k / q + k * k;
+		rb[0] = 1.0;
+		rb[1] = -2.0;
+		rb[2] = 1.0;
+		ra[1] = 2.0 * (k * k - 1.0) / a0;
+		ra[2] = (1.0 - k / q + k * k) / a0;
+	}
+
+	// Hann-windowed sinc for the three in-between phases
+	void init_oversampler()
+	{
+		const double pi = 3.14159265358979323846;
+		const double half = TAPS / 2.0;
+		for (int p = 1; p < PHASES; ++p)
+			for (int i = 0; i < TAPS; ++i) {
+				double t = half - 1.0 +
+					   (double)p / PHASES - i;
+				double sinc = std::sin(pi * t) / (pi * t);
+				double w = 0.5 * (1.0 + std::cos(pi * t /
+								 half));
+				os[p][i] = sinc * w;
+			}
+	}
+
+	// Interpolates between the samples TAPS/2 back, so the
+	// tail of the file is slightly under-sampled; harmless for
+	// a maximum
+	void track_peak(uint32_t c, double x)
+	{
+		channel_state &s = state[c];
+		peak = std::max(peak, std::fabs(x));
+		s.hist[s.pos] = x;
+		s.pos = (s.pos + 1) % TAPS;
+		for (int p = 1; p < PHASES; ++p) {
+			double y = 0.0;
+			for (int i = 0; i < TAPS; ++i)
+				y += s.hist[(s.pos + i) % TAPS] * os[p][i];
+			peak = std::max(peak, std::fabs(y));
+		}
+	}
+
+	uint32_t rate;
+	uint32_t chans;
+	uint32_t sub_len; // samples per 100 ms step
+	double weight[METER_CHANNELS];
+
+	double pb[3] = {}, pa[3] = {1.0};
+	double rb[3] = {}, ra[3] = {1.0};
+	double os[PHASES][TAPS] = {};
+	channel_state state[METER_CHANNELS];
+
+	double sub[4] = {};
+	double sub_sum = 0.0;
+	uint32_t sub_pos = 0;
+	uint32_t sub_count = 0;
+	std::vector<double> blocks; // mean-square energy
+	double peak = 0.0;
+};
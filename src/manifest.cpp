@@ -0,0 +1,319 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "manifest.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[8] = {'R', 'M', 'S', 'C', 'A', 'T', '0', '1'};
+
+// ============================================================
+//  Mapping
+// ============================================================
+struct mapped_file {
+	const char *data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+static bool map_file(const std::string &path, mapped_file &m)
+{
+	wchar_t *wpath = nullptr;
+	os_utf8_to_wcs_ptr(path.c_str(), path.size(), &wpath);
+	if (!wpath)
+		return false;
+	m.file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ,
+			     nullptr, OPEN_EXISTING,
+			     FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	bfree(wpath);
+	if (m.file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size = {};
+	bool sized = GetFileSizeEx(m.file, &size) != 0;
+	if (!sized || size.QuadPart == 0) {
+		CloseHandle(m.file);
+		m.file = INVALID_HANDLE_VALUE;
+		// An empty file maps to nothing but is readable
+		return sized;
+	}
+	m.mapping = CreateFileMappingW(m.file, nullptr, PAGE_READONLY, 0,
+				       0, nullptr);
+	if (m.mapping)
+		m.data = (const char *)MapViewOfFile(m.mapping,
+						     FILE_MAP_READ, 0, 0, 0);
+	if (!m.data) {
+		if (m.mapping)
+			CloseHandle(m.mapping);
+		CloseHandle(m.file);
+		m = mapped_file();
+		return false;
+	}
+	m.size = (size_t)size.QuadPart;
+	return true;
+}
+
+static void unmap_file(mapped_file &m)
+{
+	if (m.data)
+		UnmapViewOfFile(m.data);
+	if (m.mapping)
+		CloseHandle(m.mapping);
+	if (m.file != INVALID_HANDLE_VALUE)
+		CloseHandle(m.file);
+	m = mapped_file();
+}
+#else
+static bool map_file(const std::string &path, mapped_file &m)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	// An empty manifest is valid, it just lists nothing
+	if (st.st_size == 0) {
+		close(fd);
+		return true;
+	}
+	void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ,
+		       MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+	m.data = (const char *)p;
+	m.size = (size_t)st.st_size;
+	return true;
+}
+
+static void unmap_file(mapped_file &m)
+{
+	if (m.data)
+		munmap((void *)m.data, m.size);
+	m = mapped_file();
+}
+#endif
+
+// ============================================================
+//  Parsing
+// ============================================================
+// Paths from the root, drive letters and URLs
+static bool is_absolute(std::string_view p)
+{
+	size_t scheme = p.find("://");
+	return (!p.empty() && (p[0] == '/' || p[0] == '\\')) ||
+	       (p.size() > 1 && p[1] == ':') ||
+	       (scheme != std::string_view::npos &&
+		p.find_first_of("/\\") > scheme);
+}
+
+static void parse_text(std::string_view text, const std::string &base,
+		       manifest_filter accept, file_catalog &out)
+{
+	std::string joined;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		size_t eol = text.find('\n', pos);
+		if (eol == std::string_view::npos)
+			eol = text.size();
+		std::string_view line = text.substr(pos, eol - pos);
+		pos = eol + 1;
+
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		if (line.empty() || line[0] == '#')
+			continue;
+		size_t sep = line.find_last_of("/\\");
+		std::string_view name = sep == std::string_view::npos
+						? line
+						: line.substr(sep + 1);
+		if (accept && !accept(name))
+			continue;
+		if (is_absolute(line) || base.empty()) {
+			out.add_path(line);
+			continue;
+		}
+		joined.assign(base);
+		joined.push_back('/');
+		joined.append(line);
+		out.add_path(joined);
+	}
+}
+
+// Bounds-checked reader over the mapped bytes
+struct byte_reader {
+	const char *p;
+	const char *end;
+
+	bool u32(uint32_t &v)
+	{
+		if ((size_t)(end - p) < 4)
+			return false;
+		memcpy(&v, p, 4);
+		p += 4;
+		return true;
+	}
+	bool u64(uint64_t &v)
+	{
+		if ((size_t)(end - p) < 8)
+			return false;
+		memcpy(&v, p, 8);
+		p += 8;
+		return true;
+	}
+	bool str(std::string_view &s)
+	{
+		uint32_t len;
+		if (!u32(len) || (size_t)(end - p) < len)
+			return false;
+		s = std::string_view(p, len);
+		p += len;
+		return true;
+	}
+};
+
+static bool parse_binary(std::string_view bytes, manifest_filter accept,
+			 file_catalog &out)
+{
+	byte_reader r = {bytes.data() + sizeof(MAGIC),
+			 bytes.data() + bytes.size()};
+	uint32_t dir_count, reserved;
+	uint64_t file_count;
+	if (!r.u32(dir_count) || !r.u32(reserved) || !r.u64(file_count))
+		return false;
+	// Every directory is at least its 4-byte length, so a count
+	// the remaining bytes can't hold is a corrupt header
+	if (dir_count > (uint64_t)(r.end - r.p) / 4)
+		return false;
+
+	std::vector<uint32_t> ids;
+	ids.reserve(dir_count);
+	for (uint32_t i = 0; i < dir_count; ++i) {
+		std::string_view d;
+		if (!r.str(d))
+			return false;
+		ids.push_back(out.intern_dir(d));
+	}
+	// Every entry is at least 8 bytes, which bounds the reserve
+	out.reserve((size_t)std::min<uint64_t>(file_count,
+						(uint64_t)(r.end - r.p) / 8),
+		    (size_t)(r.end - r.p));
+	for (uint64_t i = 0; i < file_count; ++i) {
+		uint32_t dir;
+		std::string_view name;
+		if (!r.u32(dir) || dir >= dir_count || !r.str(name))
+			return false;
+		if (!accept || accept(name))
+			out.add(ids[dir], name);
+	}
+	return true;
+}
+
+bool manifest_load(const std::string &path, const std::string &origin,
+		   manifest_filter accept, file_catalog &out)
+{
+	mapped_file m;
+	if (!map_file(path, m)) {
+		blog(LOG_WARNING, "[RandomMedia] Cannot open manifest: %s",
+		     path.c_str());
+		return false;
+	}
+	std::string_view bytes(m.data ? m.data : "", m.size);
+	bool ok = true;
+	if (bytes.size() >= sizeof(MAGIC) &&
+	    memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) == 0) {
+		ok = parse_binary(bytes, accept, out);
+		if (!ok)
+			blog(LOG_WARNING,
+			     "[RandomMedia] Malformed manifest: %s",
+			     path.c_str());
+	} else {
+		const std::string &from = origin.empty() ? path : origin;
+		size_t sep = from.find_last_of("/\\");
+		std::string base = sep == std::string::npos
+					   ? std::string()
+					   : from.substr(0, sep);
+		parse_text(bytes, base, accept, out);
+	}
+	unmap_file(m);
+	return ok;
+}
+
+// ============================================================
+//  Saving
+// ============================================================
+static void put_u32(std::string &buf, uint32_t v)
+{
+	buf.append((const char *)&v, 4);
+}
+
+static void put_str(std::string &buf, std::string_view s)
+{
+	put_u32(buf, (uint32_t)s.size());
+	buf.append(s);
+}
+
+bool manifest_save(const std::string &path,
+		   const file_catalog &catalog)
+{
+	std::string buf(MAGIC, sizeof(MAGIC));
+	put_u32(buf, (uint32_t)catalog.dir_count());
+	put_u32(buf, 0);
+	uint64_t count = catalog.size();
+	buf.append((const char *)&count, 8);
+	for (uint32_t d = 0; d < (uint32_t)catalog.dir_count(); ++d)
+		put_str(buf, catalog.dir_by_id(d));
+	for (size_t i = 0; i < catalog.size(); ++i) {
+		put_u32(buf, catalog.dir_id(i));
+		put_str(buf, catalog.name(i));
+	}
+
+	std::string tmp = path + ".part";
+	FILE *f = os_fopen(tmp.c_str(), "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+	ok = fclose(f) == 0 && ok;
+	if (ok)
+		ok = os_rename(tmp.c_str(), path.c_str()) == 0;
+	if (!ok) {
+		os_unlink(tmp.c_str());
+		blog(LOG_WARNING, "[RandomMedia] Cannot write manifest: %s",
+		     path.c_str());
+	}
+	return ok;
+}
@@ -0,0 +1,51 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include "file-catalog.h"
+
+#include <string>
+#include <string_view>
+
+// ============================================================
+//  Manifests
+// ============================================================
+// A manifest lists a library's files so the catalog can be
+// loaded without walking the directories. The file is memory
+// mapped and parsed in place. Two formats are accepted:
+//
+//  - text: one path per line, UTF-8; blank lines and lines
+//    starting with '#' are skipped, relative paths are taken
+//    from the directory of 'origin' — the manifest's own
+//    path, or the URL it was downloaded from. An empty
+//    'origin' means 'path'.
+//  - binary: what manifest_save writes — the "RMSCAT01" magic,
+//    the directory table and then (dir, name) entries, in
+//    host byte order (little-endian on every OBS platform)
+//
+// 'accept' filters file names (e.g. by extension); nullptr
+// keeps everything. Returns false if the file cannot be read
+// or a binary manifest is malformed.
+typedef bool (*manifest_filter)(std::string_view name);
+
+bool manifest_load(const std::string &path, const std::string &origin,
+		   manifest_filter accept, file_catalog &out);
+
+// Writes 'catalog' as a binary manifest, atomically
+bool manifest_save(const std::string &path,
+		   const file_catalog &catalog);
@@ -0,0 +1,564 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "media-index.h"
+#include "loudness-meter.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/samplefmt.h>
+}
+
+static constexpr int INDEX_VERSION = 1;
+
+// Long files are measured from their start only
+static constexpr double MAX_ANALYSIS_SECONDS = 600.0;
+
+// The index is rewritten whole, so a folder being probed file
+// by file is flushed at most this often
+static constexpr uint64_t INDEX_SAVE_INTERVAL_NS = 5000000000ULL;
+
+struct probe_job {
+	std::string file;
+	int64_t mtime;
+	int64_t size;
+};
+
+static struct {
+	// Lookups from every instance's spawn path only share it
+	std::shared_mutex mutex;
+	std::condition_variable_any cv;
+	std::unordered_map<std::string, media_info> entries;
+	std::deque<probe_job> queue;
+	std::unordered_set<std::string> queued;
+	std::thread worker;
+	// Loudness analysis decodes the whole audio track, so it
+	// runs on its own worker once probes are done, and never
+	// holds up the metadata of later files
+	std::condition_variable_any analysis_cv;
+	std::deque<probe_job> analysis;
+	std::unordered_set<std::string> analysis_queued;
+	std::thread analyser;
+	bool stop = false;
+	bool dirty = false;
+	uint64_t saved_ns = 0; // time of the last write
+	std::string path;
+} s_index;
+
+static bool stat_file(const char *file, int64_t &mtime, int64_t &size)
+{
+	struct stat st = {};
+	if (os_stat(file, &st) != 0)
+		return false;
+	mtime = (int64_t)st.st_mtime;
+	size = (int64_t)st.st_size;
+	return true;
+}
+
+// ============================================================
+//  Probe
+// ============================================================
+static float sample_at(const AVFrame *f, int ch, int i, int channels)
+{
+	const uint8_t *plane = f->extended_data[ch];
+	const uint8_t *packed = f->extended_data[0];
+	int k = i * channels + ch;
+	switch (f->format) {
+	case AV_SAMPLE_FMT_FLTP:
+		return ((const float *)plane)[i];
+	case AV_SAMPLE_FMT_FLT:
+		return ((const float *)packed)[k];
+	case AV_SAMPLE_FMT_DBLP:
+		return (float)((const double *)plane)[i];
+	case AV_SAMPLE_FMT_DBL:
+		return (float)((const double *)packed)[k];
+	case AV_SAMPLE_FMT_S16P:
+		return ((const int16_t *)plane)[i] / 32768.0f;
+	case AV_SAMPLE_FMT_S16:
+		return ((const int16_t *)packed)[k] / 32768.0f;
+	case AV_SAMPLE_FMT_S32P:
+		return (float)(((const int32_t *)plane)[i] /
+			       2147483648.0);
+	case AV_SAMPLE_FMT_S32:
+		return (float)(((const int32_t *)packed)[k] /
+			       2147483648.0);
+	case AV_SAMPLE_FMT_U8P:
+		return (plane[i] - 128) / 128.0f;
+	case AV_SAMPLE_FMT_U8:
+		return (packed[k] - 128) / 128.0f;
+	default:
+		return 0.0f;
+	}
+}
+
+static void meter_frame(loudness_meter &meter, const AVFrame *f)
+{
+	int channels = f->ch_layout.nb_channels;
+	int used = std::min(channels, (int)loudness_meter::METER_CHANNELS);
+	float frame[loudness_meter::METER_CHANNELS];
+	for (int i = 0; i < f->nb_samples; ++i) {
+		for (int ch = 0; ch < used; ++ch)
+			frame[ch] = sample_at(f, ch, i, channels);
+		meter.add_frame(frame);
+	}
+}
+
+// Decodes the audio stream once, through the K-weighted meter
+static void analyse_loudness(AVFormatContext *fmt, int ai,
+			     media_info &info)
+{
+	info.analysed = true;
+	const AVCodecParameters *par = fmt->streams[ai]->codecpar;
+	const AVCodec *codec = avcodec_find_decoder(par->codec_id);
+	AVCodecContext *dec = codec ? avcodec_alloc_context3(codec)
+				    : nullptr;
+	if (!dec || avcodec_parameters_to_context(dec, par) < 0 ||
+	    avcodec_open2(dec, codec, nullptr) < 0 ||
+	    dec->sample_rate <= 0 || dec->ch_layout.nb_channels <= 0) {
+		avcodec_free_context(&dec);
+		return;
+	}
+
+	loudness_meter meter((uint32_t)dec->sample_rate,
+			     (uint32_t)dec->ch_layout.nb_channels);
+	uint64_t max_frames =
+		(uint64_t)(MAX_ANALYSIS_SECONDS * dec->sample_rate);
+	AVPacket *pkt = av_packet_alloc();
+	AVFrame *frame = av_frame_alloc();
+	bool eof = false;
+	while (pkt && frame && meter.frames() < max_frames) {
+		if (!eof) {
+			int ret = av_read_frame(fmt, pkt);
+			if (ret < 0) {
+				eof = true;
+				avcodec_send_packet(dec, nullptr);
+			} else if (pkt->stream_index != ai) {
+				av_packet_unref(pkt);
+				continue;
+			} else {
+				avcodec_send_packet(dec, pkt);
+				av_packet_unref(pkt);
+			}
+		}
+		int ret;
+		while ((ret = avcodec_receive_frame(dec, frame)) >= 0) {
+			meter_frame(meter, frame);
+			av_frame_unref(frame);
+		}
+		if (ret == AVERROR_EOF || (eof && ret < 0))
+			break;
+	}
+	av_frame_free(&frame);
+	av_packet_free(&pkt);
+	avcodec_free_context(&dec);
+
+	double lufs;
+	if (meter.integrated(lufs)) {
+		info.loudness_valid = true;
+		info.loudness = lufs;
+		info.true_peak = meter.true_peak_db();
+	}
+}
+
+static void probe_file(const std::string &file, media_info &info)
+{
+	AVFormatContext *fmt = nullptr;
+	if (avformat_open_input(&fmt, file.c_str(), nullptr, nullptr) <
+	    0) {
+		blog(LOG_WARNING, "[RandomMedia] Probe failed: %s",
+		     file.c_str());
+		return;
+	}
+	if (avformat_find_stream_info(fmt, nullptr) < 0) {
+		avformat_close_input(&fmt);
+		blog(LOG_WARNING, "[RandomMedia] No stream info: %s",
+		     file.c_str());
+		return;
+	}
+
+	int vi = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1,
+				     nullptr, 0);
+	if (vi >= 0) {
+		const AVCodecParameters *par =
+			fmt->streams[vi]->codecpar;
+		info.has_video = true;
+		info.width = (uint32_t)std::max(par->width, 0);
+		info.height = (uint32_t)std::max(par->height, 0);
+		info.codec = avcodec_get_name(par->codec_id);
+		AVRational fr = fmt->streams[vi]->avg_frame_rate;
+		if (fr.num > 0 && fr.den > 0)
+			info.fps = av_q2d(fr);
+	}
+	int ai = av_find_best_stream(fmt, AVMEDIA_TYPE_AUDIO, -1, -1,
+				     nullptr, 0);
+	info.has_audio = ai >= 0;
+	if (fmt->duration != AV_NOPTS_VALUE && fmt->duration > 0)
+		info.duration =
+			(double)fmt->duration / (double)AV_TIME_BASE;
+
+	avformat_close_input(&fmt);
+}
+
+// The loudness fields of 'info' only
+static void analyse_file(const std::string &file, media_info &info)
+{
+	info.analysed = true;
+	AVFormatContext *fmt = nullptr;
+	if (avformat_open_input(&fmt, file.c_str(), nullptr, nullptr) <
+	    0)
+		return;
+	if (avformat_find_stream_info(fmt, nullptr) >= 0) {
+		int ai = av_find_best_stream(fmt, AVMEDIA_TYPE_AUDIO, -1,
+					     -1, nullptr, 0);
+		if (ai >= 0)
+			analyse_loudness(fmt, ai, info);
+	}
+	avformat_close_input(&fmt);
+}
+
+// ============================================================
+//  Persistence
+// ============================================================
+static void load_index(void)
+{
+	obs_data_t *root = obs_data_create_from_json_file_safe(
+		s_index.path.c_str(), "bak");
+	if (!root)
+		return;
+	if (obs_data_get_int(root, "version") != INDEX_VERSION) {
+		obs_data_release(root);
+		return;
+	}
+
+	obs_data_array_t *files = obs_data_get_array(root, "files");
+	size_t count = obs_data_array_count(files);
+	for (size_t i = 0; i < count; ++i) {
+		obs_data_t *e = obs_data_array_item(files, i);
+		media_info info;
+		info.mtime = obs_data_get_int(e, "mtime");
+		info.size = obs_data_get_int(e, "size");
+		info.width = (uint32_t)obs_data_get_int(e, "width");
+		info.height = (uint32_t)obs_data_get_int(e, "height");
+		info.duration = obs_data_get_double(e, "duration");
+		info.codec = obs_data_get_string(e, "codec");
+		info.fps = obs_data_get_double(e, "fps");
+		info.has_video = obs_data_get_bool(e, "video");
+		info.has_audio = obs_data_get_bool(e, "audio");
+		// Absent in indexes written before loudness analysis,
+		// which queues those files again
+		info.analysed = obs_data_get_bool(e, "analysed");
+		info.loudness_valid = obs_data_get_bool(e, "lufs_valid");
+		info.loudness = obs_data_get_double(e, "lufs");
+		info.true_peak = obs_data_get_double(e, "true_peak");
+		s_index.entries[obs_data_get_string(e, "path")] = info;
+		obs_data_release(e);
+	}
+	obs_data_array_release(files);
+	obs_data_release(root);
+
+	blog(LOG_INFO, "[RandomMedia] Media index: %zu entries",
+	     s_index.entries.size());
+}
+
+// Unless 'force', writes at most once per
+// INDEX_SAVE_INTERVAL_NS; changes held back stay dirty until a
+// worker's timed wait runs out (see save_delay) or shutdown
+static void save_index(bool force)
+{
+	std::vector<std::pair<std::string, media_info>> snapshot;
+	{
+		std::lock_guard<std::shared_mutex> lk(s_index.mutex);
+		if (!s_index.dirty || s_index.path.empty())
+			return;
+		uint64_t now = os_gettime_ns();
+		if (!force &&
+		    now - s_index.saved_ns < INDEX_SAVE_INTERVAL_NS)
+			return;
+		snapshot.assign(s_index.entries.begin(),
+				s_index.entries.end());
+		s_index.dirty = false;
+		s_index.saved_ns = now;
+	}
+
+	obs_data_t *root = obs_data_create();
+	obs_data_array_t *files = obs_data_array_create();
+	for (const auto &kv : snapshot) {
+		const media_info &info = kv.second;
+		obs_data_t *e = obs_data_create();
+		obs_data_set_string(e, "path", kv.first.c_str());
+		obs_data_set_int(e, "mtime", info.mtime);
+		obs_data_set_int(e, "size", info.size);
+		obs_data_set_int(e, "width", info.width);
+		obs_data_set_int(e, "height", info.height);
+		obs_data_set_double(e, "duration", info.duration);
+		obs_data_set_string(e, "codec", info.codec.c_str());
+		obs_data_set_double(e, "fps", info.fps);
+		obs_data_set_bool(e, "video", info.has_video);
+		obs_data_set_bool(e, "audio", info.has_audio);
+		obs_data_set_bool(e, "analysed", info.analysed);
+		obs_data_set_bool(e, "lufs_valid", info.loudness_valid);
+		obs_data_set_double(e, "lufs", info.loudness);
+		obs_data_set_double(e, "true_peak", info.true_peak);
+		obs_data_array_push_back(files, e);
+		obs_data_release(e);
+	}
+	obs_data_set_int(root, "version", INDEX_VERSION);
+	obs_data_set_array(root, "files", files);
+	obs_data_array_release(files);
+
+	if (!obs_data_save_json_safe(root, s_index.path.c_str(), "tmp",
+				     "bak"))
+		blog(LOG_WARNING,
+		     "[RandomMedia] Cannot write media index: %s",
+		     s_index.path.c_str());
+	obs_data_release(root);
+}
+
+// ============================================================
+//  Probe worker
+// ============================================================
+// Caller holds the lock. How long a worker may sleep before a
+// held-back write is due.
+static std::chrono::nanoseconds save_delay(void)
+{
+	uint64_t since = os_gettime_ns() - s_index.saved_ns;
+	return std::chrono::nanoseconds(
+		since < INDEX_SAVE_INTERVAL_NS
+			? INDEX_SAVE_INTERVAL_NS - since
+			: 0);
+}
+
+// Waits on 'cv' for 'work'. While the index is dirty the wait
+// is timed, and true is returned when it ran out with nothing
+// to do but the pending write.
+static bool wait_for_work(std::unique_lock<std::shared_mutex> &lk,
+			  std::condition_variable_any &cv,
+			  bool (*work)(void))
+{
+	if (!s_index.dirty) {
+		cv.wait(lk, work);
+		return false;
+	}
+	return !cv.wait_for(lk, save_delay(), work);
+}
+
+// Caller holds the lock exclusively
+static void queue_analysis(const std::string &file, int64_t mtime,
+			   int64_t size)
+{
+	if (!s_index.analysis_queued.insert(file).second)
+		return;
+	s_index.analysis.push_back({file, mtime, size});
+	s_index.analysis_cv.notify_one();
+}
+
+static void probe_worker_loop(void)
+{
+	os_set_thread_name("random-media: probe");
+
+	std::unique_lock<std::shared_mutex> lk(s_index.mutex);
+	for (;;) {
+		bool save = wait_for_work(lk, s_index.cv, [] {
+			return s_index.stop || !s_index.queue.empty();
+		});
+		if (s_index.stop)
+			break;
+		if (save) {
+			lk.unlock();
+			save_index(false);
+			lk.lock();
+			continue;
+		}
+
+		probe_job job = std::move(s_index.queue.front());
+		s_index.queue.pop_front();
+		lk.unlock();
+
+		// Failed probes are stored too, so a broken file is
+		// not re-opened on every reload
+		media_info info;
+		info.mtime = job.mtime;
+		info.size = job.size;
+		probe_file(job.file, info);
+
+		lk.lock();
+		s_index.queued.erase(job.file);
+		if (info.has_audio)
+			queue_analysis(job.file, job.mtime, job.size);
+		s_index.entries[job.file] = std::move(info);
+		s_index.dirty = true;
+
+		// Flush once a batch of new files is done, unless a
+		// write went out moments ago
+		if (s_index.queue.empty()) {
+			lk.unlock();
+			save_index(false);
+			lk.lock();
+			// The analyser waits for the probes
+			s_index.analysis_cv.notify_one();
+		}
+	}
+}
+
+static void analysis_worker_loop(void)
+{
+	os_set_thread_name("random-media: loudness");
+
+	std::unique_lock<std::shared_mutex> lk(s_index.mutex);
+	for (;;) {
+		bool save = wait_for_work(lk, s_index.analysis_cv, [] {
+			return s_index.stop ||
+			       (!s_index.analysis.empty() &&
+				s_index.queue.empty());
+		});
+		if (s_index.stop)
+			break;
+		if (save) {
+			lk.unlock();
+			save_index(false);
+			lk.lock();
+			continue;
+		}
+
+		probe_job job = std::move(s_index.analysis.front());
+		s_index.analysis.pop_front();
+		lk.unlock();
+
+		media_info loud;
+		analyse_file(job.file, loud);
+
+		// Dropped if the file changed meanwhile; the new
+		// probe queues another pass
+		lk.lock();
+		s_index.analysis_queued.erase(job.file);
+		auto it = s_index.entries.find(job.file);
+		if (it != s_index.entries.end() &&
+		    it->second.mtime == job.mtime &&
+		    it->second.size == job.size) {
+			media_info &e = it->second;
+			e.analysed = true;
+			e.loudness_valid = loud.loudness_valid;
+			e.loudness = loud.loudness;
+			e.true_peak = loud.true_peak;
+			s_index.dirty = true;
+		}
+		if (s_index.analysis.empty()) {
+			lk.unlock();
+			save_index(false);
+			lk.lock();
+		}
+	}
+}
+
+// ============================================================
+//  Public API
+// ============================================================
+void media_index_init(void)
+{
+	char *dir = obs_module_config_path("");
+	if (dir) {
+		os_mkdirs(dir);
+		bfree(dir);
+	}
+	char *path = obs_module_config_path("media-index.json");
+	if (path) {
+		s_index.path = path;
+		bfree(path);
+	}
+
+	load_index();
+	s_index.stop = false;
+	s_index.worker = std::thread(probe_worker_loop);
+	s_index.analyser = std::thread(analysis_worker_loop);
+}
+
+void media_index_free(void)
+{
+	{
+		std::lock_guard<std::shared_mutex> lk(s_index.mutex);
+		s_index.stop = true;
+	}
+	s_index.cv.notify_all();
+	s_index.analysis_cv.notify_all();
+	if (s_index.worker.joinable())
+		s_index.worker.join();
+	if (s_index.analyser.joinable())
+		s_index.analyser.join();
+
+	// Whatever the debounce held back
+	save_index(true);
+
+	std::lock_guard<std::shared_mutex> lk(s_index.mutex);
+	s_index.entries.clear();
+	s_index.queue.clear();
+	s_index.queued.clear();
+	s_index.analysis.clear();
+	s_index.analysis_queued.clear();
+}
+
+void media_index_refresh(const std::string &file)
+{
+	int64_t mtime = 0, size = 0;
+	if (!stat_file(file.c_str(), mtime, size))
+		return;
+
+	{
+		std::lock_guard<std::shared_mutex> lk(s_index.mutex);
+		auto it = s_index.entries.find(file);
+		if (it != s_index.entries.end()) {
+			const media_info &e = it->second;
+			bool current = e.mtime == mtime && e.size == size;
+			if (current && (!e.has_audio || e.analysed))
+				return;
+			// Only the analysis is missing
+			if (current) {
+				queue_analysis(file, mtime, size);
+				return;
+			}
+			s_index.entries.erase(it);
+		}
+		if (!s_index.queued.insert(file).second)
+			return;
+		s_index.queue.push_back({file, mtime, size});
+	}
+	s_index.cv.notify_one();
+}
+
+bool media_index_lookup(const std::string &file, media_info &out)
+{
+	std::shared_lock<std::shared_mutex> lk(s_index.mutex);
+	auto it = s_index.entries.find(file);
+	if (it == s_index.entries.end())
+		return false;
+	out = it->second;
+	return true;
+}
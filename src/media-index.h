@@ -0,0 +1,63 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// ============================================================
+//  Media metadata index
+// ============================================================
+// Persistent, process-wide cache of per-file media properties,
+// stored as JSON in the module config directory. Entries are
+// keyed by path and invalidated when mtime or size change, so
+// unchanged files are never probed twice.
+struct media_info {
+	int64_t mtime = 0;
+	int64_t size = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	double duration = 0.0; // seconds, 0 for stills
+	double fps = 0.0;      // average, 0 if unknown
+	std::string codec;
+	bool has_video = false;
+	bool has_audio = false;
+
+	// EBU R128 analysis of the audio track. 'analysed' is set
+	// once it has been attempted; 'loudness_valid' only if it
+	// found audible content.
+	bool analysed = false;
+	bool loudness_valid = false;
+	double loudness = 0.0;  // integrated, LUFS
+	double true_peak = 0.0; // dBTP
+};
+
+// Loads the index from disk and starts the workers
+void media_index_init(void);
+// Stops the workers and writes the index back to disk
+void media_index_free(void);
+
+// Makes sure 'file' has an up-to-date entry, queueing a
+// background probe if it is new or changed on disk. Loudness
+// is analysed in a later pass, after pending probes, and the
+// entry is filled in once it is done.
+void media_index_refresh(const std::string &file);
+
+// Copies the entry for 'file' into 'out'; false if the file
+// has not been probed yet
+bool media_index_lookup(const std::string &file, media_info &out);
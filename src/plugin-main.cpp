@@ -16,15 +16,23 @@ You should have received a copy of the GNU General Public License along
 with this program. If not, see <https://www.gnu.org/licenses/>
 */
 #include <obs-module.h>
-#include <obs-frontend-api.h>
 #include <obs-properties.h>
 #include <util/platform.h>
+#include <util/threading.h>
+#include <sys/stat.h>
+#include <graphics/math-defs.h>
 #include <graphics/vec2.h>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
 
 OBS_DECLARE_MODULE()
@@ -40,24 +48,192 @@ MODULE_EXPORT const char *obs_module_description(void)
 //  obs-websocket vendor API (using official header from OBS)
 // ============================================================
 #include "obs-websocket-api.h"
+#include "media-index.h"
+#include "proxy-cache.h"
+#include "remote-cache.h"
+#include "folder-watcher.h"
+#include "audio-bus.h"
+#include "rcu-snapshot.h"
+#include "latency-histogram.h"
+#include "image-source.h"
+#include "timer-wheel.h"
+#include "slot-table.h"
+#include "spatial-hash.h"
+#include "selection-engine.h"
+#include "token-bucket.h"
+#include "trace-log.h"
+#include "file-catalog.h"
+#include "manifest.h"
 
 // ============================================================
 //  Plugin data
 // ============================================================
-struct random_media_data {
-	obs_source_t *source = nullptr;
-	std::string folder;
+enum class ticket_state { queued, spawned, failed };
+
+// When a queued spawn or despawn is applied: on the first video
+// tick at or after 'due_frame' that is within half a frame of
+// 'due_ns'. Unset, spawns apply as soon as they are ready.
+struct spawn_schedule {
+	bool set = false;
+	uint64_t due_ns = 0;
+	uint64_t due_frame = 0;
+};
+
+// 'count' of 0 uses the spawn_count setting; 'files' are
+// explicit picks from spawn_batch
+// Requests waiting on the resource budget carry the handles
+// they spawned so far.
+struct spawn_request {
+	uint64_t ticket;
+	uint64_t queued_ns;
+	int count;
+	std::vector<std::string> files;
+	std::vector<uint64_t> handles = {};
+	uint64_t wait_ns = 0; // when it started waiting on budget
+	spawn_schedule schedule = {};
+	bool needs_token = false; // queued over the rate limit
+	// Tickets coalesced into this one; they settle with it
+	std::vector<uint64_t> merged = {};
+};
+
+// A despawn waiting for its tick; 'all' ignores 'handle'
+struct scheduled_despawn {
+	uint64_t handle;
+	bool all;
+	spawn_schedule schedule;
+};
+struct scheduled_spawn;
+
+static constexpr size_t SPAWN_QUEUE_MAX = 64;
+static constexpr size_t TICKET_HISTORY = 256;
+// How far ahead a request may be scheduled; its sources are
+// opened on arrival and held until then
+static constexpr uint64_t SCHEDULE_MAX_NS = 10000000000ULL;
+
+// A pooled source that already has its next file loaded;
+// width/height are the proxy's size if one was loaded instead
+struct lookahead_entry {
+	std::string file;
+	obs_source_t *source;
+	uint32_t width;
+	uint32_t height;
+};
+
+typedef rcu_snapshot<file_catalog> file_list_t;
+
+// Where the catalog comes from: a manifest if one is set,
+// otherwise a walk of the roots (the folder, then the extras)
+struct library_config {
+	std::vector<std::string> roots;
+	std::string manifest;
+	bool recursive = false;
+	std::string weights; // sidecar for weight_source::sidecar
+};
+
+struct item_ctx;
+struct item_transform {
+	vec2 pos;
+	vec2 scale;
+	float rot; // degrees, about the top-left corner
+};
+
+// An item drawn directly by the compositor pass
+struct comp_item {
+	obs_source_t *media;
+	item_transform xf;
+};
+
+static constexpr uint64_t LIFETIME_RESOLUTION_NS = 100000000ULL;
+static constexpr uint32_t ITEM_SLOTS = 1024;
+
+// Estimated cost of one live item
+struct resource_cost {
+	uint64_t decoder_bytes = 0; // decoded surfaces in RAM
+	uint64_t vram_bytes = 0;    // textures
+	uint64_t pixels_per_sec = 0; // decode rate
+
+	resource_cost &operator+=(const resource_cost &o)
+	{
+		decoder_bytes += o.decoder_bytes;
+		vram_bytes += o.vram_bytes;
+		pixels_per_sec += o.pixels_per_sec;
+		return *this;
+	}
+	resource_cost &operator-=(const resource_cost &o)
+	{
+		decoder_bytes -= std::min(decoder_bytes, o.decoder_bytes);
+		vram_bytes -= std::min(vram_bytes, o.vram_bytes);
+		pixels_per_sec -= std::min(pixels_per_sec, o.pixels_per_sec);
+		return *this;
+	}
+};
+
+// What a spawn does when its item would exceed the budget
+enum class budget_policy { queue, replace, drop };
+
+// Which clips ffmpeg_source decodes in hardware: none, those
+// whose probed codec has a common hardware decoder, or all
+enum class decode_policy { software, automatic, hardware };
+
+// What happens to a trigger over the rate limit, and to items
+// over max_active: dropped, queued until there is room, or —
+// for the rate limit — folded into the newest queued request
+enum class storm_policy { drop, queue, merge };
+
+// Where pick weights come from: none, the weights sidecar, or
+// the index's durations (equal screen time per clip)
+enum class weight_source { none, sidecar, duration };
+
+static constexpr uint64_t BUDGET_WAIT_MAX_NS = 30000000000ULL;
+static constexpr int BUDGET_REPLACE_TRIES = 8;
+
+// Spread placement tries this many random spots for a free one
+// before settling for an overlap
+static constexpr int PLACE_TRIES = 12;
+
+struct ticket_info {
+	ticket_state state;
+	std::vector<uint64_t> handles; // items it spawned
+};
+
+// Stages of a spawn, timed separately for the stats request
+enum spawn_stage {
+	STAGE_CREATE,      // pool acquire + load file
+	STAGE_SETUP,       // volume, mute, monitoring
+	STAGE_FILTERS,     // apply_audio_filters
+	STAGE_SCENE_ADD,   // obs_scene_add
+	STAGE_TRANSFORM,   // random position/scale/rotation
+	STAGE_FIRST_FRAME, // obs_scene_add to media_started
+	STAGE_COUNT
+};
+
+static const char *const s_stage_names[STAGE_COUNT] = {
+	"create",    "setup",     "filters",
+	"scene_add", "transform", "first_frame",
+};
+
+// Every tunable from the settings dialog. source_update builds
+// a new one and publishes it whole, so a reader never sees half
+// an update; the struct is flat, so a spawn's copy is cheap.
+struct source_config {
 	bool do_random_transform = true;
 	bool hide_on_end = true;
+	float image_duration = 5.0f; // seconds a still stays up
+	int max_lifetime = 300;      // seconds
+
+	// Compositor mode draws items straight from comp_items in
+	// one pass, skipping the overlay scene and its items
+	bool use_compositor = false;
 
 	// Transform — relative to canvas (0.0 – 1.0)
 	// Position randomised so item stays fully ON canvas
-	float min_scale = 20.0f;  // % of canvas width
+	float min_scale = 20.0f; // % of canvas width
 	float max_scale = 40.0f;
 	bool preserve_aspect = true;
 	float min_rot = -30.0f;
 	float max_rot = 30.0f;
 	bool disable_rot = false;
+	bool spread_placement = false;
 
 	// Volume
 	float volume_db = -6.0f;
@@ -74,36 +250,289 @@ struct random_media_data {
 	bool use_limiter = true;
 	float limiter_threshold = -1.0f;
 
+	// Shared bus — one compressor/limiter for the summed mix
+	// instead of a filter pair on every spawned item
+	bool use_audio_bus = false;
+
+	// Normalize — one static gain from the index's loudness
+	// analysis instead of live filters; files not analysed yet
+	// fall back to the per-item compressor/limiter
+	bool normalize_audio = false;
+	float target_lufs = -18.0f;
+
 	int spawn_count = 1;
 	int max_active = 5;
 
-	std::vector<std::string> file_list;
+	// Resource budget — limits of 0 are unlimited
+	uint64_t budget_decoder = 0; // bytes
+	uint64_t budget_vram = 0;    // bytes
+	uint64_t budget_pps = 0;     // pixels per second
+	budget_policy policy = budget_policy::queue;
+
+	int pool_min = 2;
+	int pool_max = 8;
+	int lookahead = 2;
+
+	// Oversized clips play from downscaled proxies once the
+	// background transcode has made them
+	bool use_proxies = false;
+
+	// Remote files picked ahead of time and queued for
+	// download; only those already cached are spawned
+	int remote_prefetch = 8;
+
+	selection_engine::mode selection = selection_engine::mode::random;
+	weight_source weighting = weight_source::none;
+
+	// Per-spawn log lines; the trace log always has the events
+	bool verbose_log = false;
+
+	// Spawns and despawns are applied on the video tick, all
+	// of a frame's changes in one scene update
+	bool frame_aligned = false;
+
+	// Trigger storm control — 'rate_limit' triggers per second
+	// (0 = off) in bursts of up to 'rate_burst'. Requests that
+	// arrive within 'coalesce_ms' of each other spawn as one
+	// batch.
+	double rate_limit = 0.0;
+	int rate_burst = 10;
+	storm_policy storm = storm_policy::drop;
+	int coalesce_ms = 0;
+
+	decode_policy decode = decode_policy::software;
+};
+
+typedef rcu_snapshot<source_config> config_t;
+typedef rcu_snapshot<library_config> library_t;
+
+struct random_media_data {
+	obs_source_t *source = nullptr;
+	// Private scene the items are spawned into
+	obs_scene_t *overlay = nullptr;
+
+	// Tunables, replaced whole by source_update. Spawns copy
+	// one snapshot at the start and use only that.
+	config_t config;
+	// What to catalog; read by reloads and watcher rescans
+	library_t library;
+
+	// Compositor mode draws items straight from comp_items in
+	// one pass, skipping the overlay scene and its items
+	std::mutex comp_mutex;
+	std::vector<comp_item> comp_items;
+
+	// Spread placement keeps the bounding boxes of live items
+	// in a spatial hash so new items land on free canvas
+	std::mutex place_mutex;
+	spatial_hash placed{64.0f};
+	uint64_t next_place_id = 0; // guarded by place_mutex
+	std::atomic<uint64_t> place_overlaps{0};
+
+	// Shared bus, created the first time it is enabled
+	audio_bus *bus = nullptr;
+
+	std::atomic<uint64_t> normalized{0};
+	std::atomic<uint64_t> normalize_fallbacks{0};
+
+	// Resource budget — 'usage' is guarded by active_mutex,
+	// 'budget_wait' by queue_mutex
+	resource_cost usage;
+	std::deque<spawn_request> budget_wait;
+	bool budget_freed = false;
+	std::atomic<uint64_t> budget_deferred{0};
+	std::atomic<uint64_t> budget_replaced{0};
+	std::atomic<uint64_t> budget_dropped{0};
+
+	// Source pool — idle ffmpeg_sources reused across spawns
+	std::mutex pool_mutex;
+	std::vector<obs_source_t *> pool_idle;
+	std::atomic<uint64_t> pool_hits{0};
+	std::atomic<uint64_t> pool_misses{0};
+
+	// Decode paths of live clips, and of every clip opened
+	std::atomic<int> live_hw{0};
+	std::atomic<int> live_sw{0};
+	std::atomic<uint64_t> opened_hw{0};
+	std::atomic<uint64_t> opened_sw{0};
+	std::atomic<uint64_t> hw_fallbacks{0};
+
+	// Lookahead — the next picks, pre-opened in hidden sources
+	std::mutex lookahead_mutex;
+	std::deque<lookahead_entry> lookahead_queue;
+	std::atomic<bool> lookahead_refill{false};
+	latency_histogram start_hit;
+	latency_histogram start_miss;
+
+	// Selection — the order files are picked in, rebuilt when
+	// 'select_gen' moves on. The sidecar weights are kept
+	// until the file changes. Guarded by select_mutex.
+	std::mutex select_mutex;
+	selection_engine selector;
+	std::atomic<uint64_t> select_gen{1};
+	uint64_t select_built = 0;
+	std::string weights_path;
+	int64_t weights_mtime = 0;
+	std::unordered_map<std::string, double> weights_map;
+	// Picks passed over with no remote copy ready
+	std::atomic<uint64_t> remote_skipped{0};
+
+	// Published as an immutable snapshot: spawns read it
+	// without locking while reloads and watcher edits swap in
+	// a new one
+	file_list_t file_list;
+	std::vector<folder_watcher *> watchers; // one per root
+
+	// Background reload — one scan at a time, published when it
+	// completes. 'reload_job' is the latest job started,
+	// 'reload_done' the latest one published.
+	std::mutex reload_mutex; // serialises start/cancel
+	std::thread reload_thread;
+	std::atomic<bool> reload_cancel{false};
+	std::atomic<uint64_t> reload_job{0};
+	std::atomic<uint64_t> reload_done{0};
+
+	// Warm start — 'warming' is set by the first update if the
+	// list came from the snapshot; the pool, the lookahead, the
+	// watchers and the folder check then wait for the warm
+	// thread. 'warm_mutex' serialises it with source_update.
+	bool created = false;
+	std::atomic<bool> warming{false};
+	std::mutex warm_mutex;
+	std::atomic<size_t> reload_scanned{0};
+
+	// Live items by handle, each with a max-lifetime timer
 	std::mutex active_mutex;
-	std::vector<obs_sceneitem_t *> active_items;
+	slot_table<item_ctx *> live{ITEM_SLOTS};
+	timer_wheel lifetimes{LIFETIME_RESOLUTION_NS, os_gettime_ns()};
+	std::vector<uint64_t> expired_ids;
+
+	// Spawn queue — requests are queued by vendor/hotkey
+	// callbacks and drained by spawn_worker
+	std::mutex queue_mutex;
+	std::condition_variable queue_cv;
+	std::deque<spawn_request> spawn_queue;
+	std::unordered_map<uint64_t, ticket_info> tickets;
+	std::deque<uint64_t> ticket_order;
+	bool worker_stop = false;
+	std::thread spawn_worker;
+	latency_histogram queue_wait;
+
+	// Admission — 'bucket' is guarded by queue_mutex,
+	// 'reserved' (max_active slots held by batches in flight)
+	// by active_mutex
+	token_bucket bucket;
+	int reserved = 0;
+	std::atomic<uint64_t> rate_dropped{0};
+	std::atomic<uint64_t> rate_queued{0};
+	std::atomic<uint64_t> rate_merged{0};
+	std::atomic<uint64_t> coalesced{0};
+	std::atomic<uint64_t> cap_held{0};
+
+	// Prepared batches and despawns waiting for the video tick
+	// (frame-aligned mode or an explicit schedule);
+	// 'frame_count' counts schedule_tick calls
+	std::mutex sched_mutex;
+	std::vector<scheduled_spawn *> scheduled;
+	std::vector<scheduled_despawn> despawns;
+	std::atomic<uint64_t> frame_count{0};
+	std::atomic<uint64_t> sched_batches{0};
+	std::atomic<uint64_t> sched_late{0};
+
+	// Spawn latency per stage; 'dropped' counts requests lost
+	// to a full queue or the max_active cap
+	latency_histogram stages[STAGE_COUNT];
+	std::atomic<uint64_t> dropped{0};
+
+	// Per-instance spawn hotkey, listed under the source
+	obs_hotkey_id hotkey = OBS_INVALID_HOTKEY_ID;
+	uint64_t instance_no = 0; // creation order
 };
 
-static random_media_data *g_data = nullptr;
+// One consistent copy of the settings
+static source_config config_of(random_media_data *data)
+{
+	config_t::reader cfg(data->config);
+	return *cfg;
+}
+
+// Every live instance by source UUID. Vendor callbacks look
+// instances up under a reader guard, and source_destroy
+// unregisters before teardown, which waits those readers out.
+typedef rcu_snapshot<std::unordered_map<std::string, random_media_data *>>
+	instance_map_t;
+static instance_map_t g_instances;
+static std::atomic<uint64_t> g_instance_count{0};
 static bool g_vendor_registered = false;
-static obs_hotkey_id g_hotkey_spawn = OBS_INVALID_HOTKEY_ID;
 
 // Forward declarations
 static void vendor_spawn_cb(obs_data_t *, obs_data_t *,
 			    void *);
 static void vendor_reload_cb(obs_data_t *, obs_data_t *,
 			     void *);
-static void do_spawn(random_media_data *data);
+static void vendor_spawn_status_cb(obs_data_t *, obs_data_t *,
+				   void *);
+static void vendor_stats_cb(obs_data_t *, obs_data_t *, void *);
+static void vendor_spawn_batch_cb(obs_data_t *, obs_data_t *,
+				  void *);
+static void vendor_despawn_cb(obs_data_t *, obs_data_t *, void *);
+static void vendor_despawn_all_cb(obs_data_t *, obs_data_t *,
+				  void *);
+static void vendor_instances_cb(obs_data_t *, obs_data_t *, void *);
+static void vendor_trace_export_cb(obs_data_t *, obs_data_t *,
+				   void *);
+static void vendor_save_manifest_cb(obs_data_t *, obs_data_t *,
+				    void *);
+static bool do_spawn(random_media_data *data, obs_scene_t *target,
+		     int count, const std::vector<std::string> &files,
+		     uint64_t trigger_ns, std::vector<uint64_t> *handles,
+		     std::vector<std::string> *deferred, int *capped);
+static uint64_t enqueue_spawn(random_media_data *data, int count,
+			      std::vector<std::string> files,
+			      spawn_schedule schedule, const char **error);
+static void request_lookahead_refill(random_media_data *data);
+static void vendor_reload_status_cb(obs_data_t *, obs_data_t *,
+				    void *);
 
 // Hotkey callback
-static void hotkey_spawn_cb(void * /*data*/,
+static void hotkey_spawn_cb(void *priv,
 			    obs_hotkey_id /*id*/,
 			    obs_hotkey_t * /*hotkey*/,
 			    bool pressed)
 {
-	if (!pressed || !g_data)
+	if (!pressed)
 		return;
-	blog(LOG_INFO,
-	     "[RandomMedia] Hotkey triggered");
-	do_spawn(g_data);
+	auto *data = static_cast<random_media_data *>(priv);
+	if (config_of(data).verbose_log)
+		blog(LOG_INFO,
+		     "[RandomMedia] Hotkey triggered on '%s'",
+		     obs_source_get_name(data->source));
+	enqueue_spawn(data, 0, {}, spawn_schedule{}, nullptr);
+}
+
+// The frontend hotkey from before hotkeys went per source, kept
+// under its old name so existing bindings and TriggerHotkeyByName
+// calls still work. It spawns on the sole instance, or the one
+// created first when there are several.
+static void hotkey_compat_spawn_cb(void * /*priv*/,
+				   obs_hotkey_id /*id*/,
+				   obs_hotkey_t * /*hotkey*/,
+				   bool pressed)
+{
+	if (!pressed)
+		return;
+	instance_map_t::reader instances(g_instances);
+	random_media_data *first = nullptr;
+	for (const auto &kv : *instances)
+		if (!first || kv.second->instance_no < first->instance_no)
+			first = kv.second;
+	if (!first)
+		return;
+	if (config_of(first).verbose_log)
+		blog(LOG_INFO,
+		     "[RandomMedia] Frontend hotkey triggered on '%s'",
+		     obs_source_get_name(first->source));
+	enqueue_spawn(first, 0, {}, spawn_schedule{}, nullptr);
 }
 
 static obs_websocket_vendor g_vendor = nullptr;
@@ -123,9 +552,36 @@ static void try_register_vendor(void)
 	obs_websocket_vendor_register_request(
 		g_vendor, "spawn",
 		vendor_spawn_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "spawn_batch",
+		vendor_spawn_batch_cb, nullptr);
 	obs_websocket_vendor_register_request(
 		g_vendor, "reload_files",
 		vendor_reload_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "reload_status",
+		vendor_reload_status_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "despawn",
+		vendor_despawn_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "despawn_all",
+		vendor_despawn_all_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "stats",
+		vendor_stats_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "spawn_status",
+		vendor_spawn_status_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "instances",
+		vendor_instances_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "trace_export",
+		vendor_trace_export_cb, nullptr);
+	obs_websocket_vendor_register_request(
+		g_vendor, "save_manifest",
+		vendor_save_manifest_cb, nullptr);
 	g_vendor_registered = true;
 	blog(LOG_INFO,
 	     "[RandomMedia] WebSocket vendor READY"
@@ -139,319 +595,3226 @@ static const char *MEDIA_EXTS[] = {
 	".mp4", ".mkv", ".avi", ".mov", ".webm",
 	".flv", ".jpg", ".jpeg", ".png", ".gif", nullptr};
 
-static bool has_media_ext(const char *name)
+// Stills go to the image source instead of ffmpeg_source. GIFs
+// may be animated, so they stay on the decoder path.
+static const char *STILL_EXTS[] = {".jpg", ".jpeg", ".png",
+				   nullptr};
+
+static bool has_ext(std::string_view name, const char *const *exts)
 {
-	const char *dot = strrchr(name, '.');
-	if (!dot)
+	size_t dot = name.rfind('.');
+	if (dot == std::string_view::npos)
 		return false;
 	char ext[16] = {};
-	size_t i = 0;
-	for (const char *p = dot; *p && i < 15; ++p, ++i)
-		ext[i] = (char)tolower((unsigned char)*p);
-	for (int k = 0; MEDIA_EXTS[k]; ++k)
-		if (strcmp(ext, MEDIA_EXTS[k]) == 0)
+	for (size_t i = 0; dot + i < name.size() && i < 15; ++i)
+		ext[i] = (char)tolower((unsigned char)name[dot + i]);
+	for (int k = 0; exts[k]; ++k)
+		if (strcmp(ext, exts[k]) == 0)
 			return true;
 	return false;
 }
 
-static void update_file_list(random_media_data *data)
+static bool has_media_ext(std::string_view name)
 {
-	data->file_list.clear();
-	if (data->folder.empty())
-		return;
-	os_dir_t *dir = os_opendir(data->folder.c_str());
-	if (!dir) {
+	return has_ext(name, MEDIA_EXTS);
+}
+
+static bool is_still_image(const std::string &file)
+{
+	return has_ext(file, STILL_EXTS);
+}
+
+static bool is_dot_dir(const char *name)
+{
+	return strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+}
+
+// Counts files as a scan goes and lets it be abandoned
+struct scan_progress {
+	std::atomic<size_t> *scanned;
+	const std::atomic<bool> *cancel;
+};
+
+static void scan_dir(const std::string &dir, bool recursive,
+		     file_catalog &out, const scan_progress *progress)
+{
+	os_dir_t *d = os_opendir(dir.c_str());
+	if (!d) {
 		blog(LOG_WARNING,
 		     "[RandomMedia] Cannot open folder: %s",
-		     data->folder.c_str());
+		     dir.c_str());
 		return;
 	}
+	// Interned on the first media file, so empty directories
+	// never reach the catalog
+	uint32_t dir_id = UINT32_MAX;
 	struct os_dirent *ent;
-	while ((ent = os_readdir(dir))) {
-		if (ent->directory)
+	while ((ent = os_readdir(d))) {
+		if (progress && *progress->cancel)
+			break;
+		if (ent->directory) {
+			if (recursive && !is_dot_dir(ent->d_name))
+				scan_dir(dir + "/" + ent->d_name, true,
+					 out, progress);
 			continue;
+		}
 		if (!has_media_ext(ent->d_name))
 			continue;
-		std::string f = data->folder + "/" + ent->d_name;
-		data->file_list.push_back(f);
+		media_index_refresh(dir + "/" + ent->d_name);
+		if (dir_id == UINT32_MAX)
+			dir_id = out.intern_dir(dir);
+		out.add(dir_id, ent->d_name);
+		if (progress)
+			++*progress->scanned;
+	}
+	os_closedir(d);
+}
+
+// Builds the catalog from the manifest if there is one, from a
+// walk of every root otherwise. Manifest entries are not probed
+// up front: a library is listed precisely so that millions of
+// files need not be touched.
+static bool build_catalog(const library_config &lib, file_catalog &out,
+			  const scan_progress *progress)
+{
+	if (!lib.manifest.empty()) {
+		// A remote manifest is fetched fresh on every load
+		std::string local = lib.manifest;
+		if (remote_is_url(lib.manifest) &&
+		    !remote_cache_fetch(lib.manifest, local)) {
+			blog(LOG_WARNING,
+			     "[RandomMedia] Cannot download manifest: %s",
+			     lib.manifest.c_str());
+			return false;
+		}
+		bool ok = manifest_load(
+			local, lib.manifest,
+			[](std::string_view name) {
+				// URLs may carry a query string
+				return has_media_ext(
+					name.substr(0, name.find_first_of("?#")));
+			},
+			out);
+		if (progress)
+			*progress->scanned = out.size();
+		return ok;
+	}
+	for (const std::string &root : lib.roots) {
+		if (progress && *progress->cancel)
+			break;
+		scan_dir(root, lib.recursive, out, progress);
 	}
-	os_closedir(dir);
-	blog(LOG_INFO, "[RandomMedia] Found %zu files in '%s'",
-	     data->file_list.size(), data->folder.c_str());
+	return true;
+}
+
+static library_config library_of(random_media_data *data)
+{
+	library_t::reader lib(data->library);
+	return *lib;
+}
+
+static std::string describe(const library_config &lib)
+{
+	if (!lib.manifest.empty())
+		return "manifest '" + lib.manifest + "'";
+	if (lib.roots.size() == 1)
+		return "'" + lib.roots[0] + "'";
+	return std::to_string(lib.roots.size()) + " folders";
 }
 
 // ============================================================
-//  Media-ended callback
+//  Catalog snapshot
 // ============================================================
-struct hide_ctx {
-	random_media_data *data;
-	obs_sceneitem_t *item;
-	obs_source_t *media_source;
-};
+// Every full build is saved as a binary manifest in the module
+// config directory, named after a hash of the library, so the
+// next start can restore the list without touching the folders
+// and check them later in the background.
+static std::string snapshot_path(const library_config &lib)
+{
+	std::string key = lib.manifest;
+	key += lib.recursive ? "\nR" : "\nF";
+	for (const std::string &root : lib.roots)
+		key += "\n" + root;
+	// FNV-1a, so the name is the same across runs and builds
+	uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : key) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	char name[40];
+	snprintf(name, sizeof(name), "catalogs/%016llx.rmscat",
+		 (unsigned long long)h);
+	char *path = obs_module_config_path(name);
+	if (!path)
+		return {};
+	std::string out = path;
+	bfree(path);
+	return out;
+}
+
+static bool load_snapshot(const library_config &lib, file_catalog &out)
+{
+	if (lib.roots.empty() && lib.manifest.empty())
+		return false;
+	std::string path = snapshot_path(lib);
+	struct stat st;
+	if (path.empty() || stat(path.c_str(), &st) != 0)
+		return false;
+	return manifest_load(path, {}, nullptr, out) && out.size();
+}
+
+// An empty build is not saved — it is more likely an unmounted
+// drive than an empty library
+static void save_snapshot(const library_config &lib,
+			  const file_catalog &files)
+{
+	if (!files.size())
+		return;
+	std::string path = snapshot_path(lib);
+	if (path.empty())
+		return;
+	char *dir = obs_module_config_path("catalogs");
+	if (dir) {
+		os_mkdirs(dir);
+		bfree(dir);
+	}
+	manifest_save(path, files);
+}
+
+// The largest size an item is drawn at, as a proxy box. Zero
+// width when items are shown at natural size.
+static void proxy_box(const source_config &cfg, uint32_t &w,
+		      uint32_t &h)
+{
+	w = h = 0;
+	struct obs_video_info ovi = {};
+	if (!cfg.do_random_transform || !obs_get_video_info(&ovi))
+		return;
+	float smax = std::max(cfg.min_scale, cfg.max_scale) / 100.0f;
+	w = (uint32_t)std::ceil(smax * (float)ovi.base_width);
+	if (!cfg.preserve_aspect)
+		h = (uint32_t)std::ceil(smax * (float)ovi.base_height);
+}
+
+static void request_proxies(random_media_data *data,
+			    const file_catalog &files)
+{
+	source_config cfg = config_of(data);
+	if (!cfg.use_proxies)
+		return;
+	uint32_t w, h;
+	proxy_box(cfg, w, h);
+	if (!w)
+		return;
+	for (size_t i = 0; i < files.size(); ++i) {
+		std::string f = files.path(i);
+		if (!is_still_image(f) && !remote_is_url(f))
+			proxy_cache_request(f, w, h);
+	}
+}
+
+// ============================================================
+//  Selection
+// ============================================================
+// Picks come from the source's selection engine, which is
+// rebuilt lazily whenever 'select_gen' moves on: a new or
+// edited catalog, or new selection settings.
+
+// "<weight> <path>" per line, '#' for comments; relative paths
+// are taken from the sidecar's own directory
+static void load_weights(const std::string &path,
+			 std::unordered_map<std::string, double> &out)
+{
+	out.clear();
+	char *text = os_quick_read_utf8_file(path.c_str());
+	if (!text) {
+		blog(LOG_WARNING, "[RandomMedia] Cannot read weights: %s",
+		     path.c_str());
+		return;
+	}
+	size_t sep = path.find_last_of("/\\");
+	std::string base = sep == std::string::npos ? std::string()
+						    : path.substr(0, sep + 1);
+	std::string_view all(text);
+	while (!all.empty()) {
+		size_t eol = all.find('\n');
+		std::string_view line = all.substr(0, eol);
+		all.remove_prefix(eol == std::string_view::npos ? all.size()
+								: eol + 1);
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+		size_t space = line.find_first_of(" \t");
+		if (line.empty() || line[0] == '#' ||
+		    space == std::string_view::npos)
+			continue;
+		double w = strtod(std::string(line.substr(0, space)).c_str(),
+				  nullptr);
+		std::string_view file = line.substr(space + 1);
+		file.remove_prefix(std::min(file.find_first_not_of(" \t"),
+					    file.size()));
+		if (file.empty())
+			continue;
+		bool absolute = file[0] == '/' || file[0] == '\\' ||
+				file.find(':') != std::string_view::npos;
+		out[absolute ? std::string(file)
+			     : base + std::string(file)] = w;
+	}
+	bfree(text);
+	blog(LOG_INFO, "[RandomMedia] Loaded %zu weight(s) from %s",
+	     out.size(), path.c_str());
+}
+
+// Caller holds select_mutex and a reader on 'files'
+static void select_sync_locked(random_media_data *data,
+			       const file_catalog &files)
+{
+	uint64_t gen = data->select_gen;
+	if (gen == data->select_built &&
+	    data->selector.size() == files.size())
+		return;
+	data->select_built = gen;
+
+	source_config cfg = config_of(data);
+	std::vector<double> weights;
+	if (cfg.weighting == weight_source::sidecar) {
+		std::string path = library_of(data).weights;
+		struct stat st = {};
+		int64_t mtime = os_stat(path.c_str(), &st) == 0
+					? (int64_t)st.st_mtime
+					: 0;
+		if (path != data->weights_path ||
+		    mtime != data->weights_mtime) {
+			load_weights(path, data->weights_map);
+			data->weights_path = path;
+			data->weights_mtime = mtime;
+		}
+		// Unlisted files keep the neutral weight
+		weights.assign(files.size(), 1.0);
+		if (!data->weights_map.empty())
+			for (size_t i = 0; i < files.size(); ++i) {
+				auto it = data->weights_map.find(files.path(i));
+				if (it != data->weights_map.end())
+					weights[i] = it->second;
+			}
+	} else if (cfg.weighting == weight_source::duration) {
+		// Equal screen time: short clips come up more often.
+		// Unprobed files count as 10 s.
+		weights.resize(files.size());
+		media_info info;
+		for (size_t i = 0; i < files.size(); ++i) {
+			std::string f = files.path(i);
+			double d = 10.0;
+			if (is_still_image(f))
+				d = cfg.image_duration;
+			else if (media_index_lookup(f, info) &&
+				 info.duration > 0.0)
+				d = info.duration;
+			weights[i] = 1.0 / std::max(d, 1.0);
+		}
+	}
+	data->selector.reset(files.size(), std::move(weights),
+			     cfg.selection);
+}
+
+// Caller holds select_mutex. Queues downloads for the remote
+// entries among the next 'window' picks, in pick order.
+static void remote_prefetch_locked(random_media_data *data,
+				   const file_catalog &files,
+				   size_t window)
+{
+	for (uint32_t i : data->selector.peek(window)) {
+		std::string p = files.path(i);
+		if (remote_is_url(p))
+			remote_cache_request(p);
+	}
+}
+
+static size_t prefetch_window(random_media_data *data)
+{
+	return (size_t)std::max(1, config_of(data).remote_prefetch);
+}
+
+// Rebuilds the order for a new library and starts its
+// downloads straight away
+static void remote_prefetch(random_media_data *data)
+{
+	size_t window = prefetch_window(data);
+	file_list_t::reader files(data->file_list);
+	if (files->empty())
+		return;
+	std::lock_guard<std::mutex> lk(data->select_mutex);
+	select_sync_locked(data, *files);
+	remote_prefetch_locked(data, *files, window);
+}
+
+static void publish_file_list(random_media_data *data,
+			      file_catalog files,
+			      const library_config &lib)
+{
+	request_proxies(data, files);
+	size_t count = files.size();
+	size_t dirs = files.dir_count();
+	size_t bytes = files.arena_bytes();
+	data->file_list.publish(std::move(files));
+	data->select_gen++;
+	remote_prefetch(data);
+	blog(LOG_INFO,
+	     "[RandomMedia] Found %zu files in %s (%zu dirs,"
+	     " %zu name bytes)",
+	     count, describe(lib).c_str(), dirs, bytes);
+}
+
+// Synchronous rescan for the watcher thread when it reports
+// dropped events; everything else goes through start_reload
+static void update_file_list(random_media_data *data)
+{
+	library_config lib = library_of(data);
+	file_catalog files;
+	build_catalog(lib, files, nullptr);
+	save_snapshot(lib, files);
+	publish_file_list(data, std::move(files), lib);
+}
+
+static size_t file_count(random_media_data *data)
+{
+	file_list_t::reader files(data->file_list);
+	return files->size();
+}
+
+// The next picks in the selection order; each pick's path is
+// built once, as the spawn has to own it past the snapshot's
+// lifetime. A remote entry that is not cached yet is passed
+// over for the first ready one behind it — it stays next in
+// line while it downloads — so a pick never waits on the
+// network. With nothing ready in the window the pick is
+// skipped.
+static void pick_files(random_media_data *data, size_t count,
+		       std::vector<std::string> &out)
+{
+	size_t window = prefetch_window(data);
+	file_list_t::reader files(data->file_list);
+	if (files->empty())
+		return;
+	std::lock_guard<std::mutex> lk(data->select_mutex);
+	select_sync_locked(data, *files);
+
+	std::string found;
+	bool is_remote = false;
+	auto ready = [&](uint32_t i) {
+		found = files->path(i);
+		is_remote = remote_is_url(found);
+		return !is_remote ||
+		       remote_cache_lookup(std::string(found), found);
+	};
+	bool remote = false;
+	for (size_t n = 0; n < count; ++n) {
+		uint32_t idx;
+		if (data->selector.take_first(ready, window, idx)) {
+			remote |= is_remote;
+			out.push_back(std::move(found));
+		} else {
+			remote = true;
+			data->remote_skipped++;
+		}
+	}
+	if (remote)
+		remote_prefetch_locked(data, *files, window);
+}
+
+// Independent picks that leave the order alone, e.g. to find
+// a cheaper replacement. Uncached remote entries are dropped.
+static void sample_files(random_media_data *data, size_t count,
+			 std::vector<std::string> &out)
+{
+	file_list_t::reader files(data->file_list);
+	if (files->empty())
+		return;
+	std::lock_guard<std::mutex> lk(data->select_mutex);
+	select_sync_locked(data, *files);
+	std::string local;
+	for (size_t n = 0; n < count; ++n) {
+		std::string p = files->path(data->selector.sample());
+		if (!remote_is_url(p))
+			out.push_back(std::move(p));
+		else if (remote_cache_lookup(p, local))
+			out.push_back(local);
+	}
+}
+
+// ============================================================
+//  Folder watching
+// ============================================================
+static bool is_under(std::string_view path, std::string_view root)
+{
+	return path.size() >= root.size() &&
+	       path.compare(0, root.size(), root) == 0 &&
+	       (path.size() == root.size() || path[root.size()] == '/');
+}
+
+// Applies a batch of watcher deltas to file_list in one copy,
+// instead of rescanning. Runs on the watcher thread.
+static void on_folder_events(random_media_data *data,
+			     const std::vector<folder_event> &batch)
+{
+	for (const folder_event &ev : batch)
+		if (ev.type == folder_event_type::rescan) {
+			blog(LOG_INFO,
+			     "[RandomMedia] Watcher overflow — rescanning");
+			update_file_list(data);
+			return;
+		}
+
+	// New files are found before the copy is taken
+	bool recursive = library_of(data).recursive;
+	std::vector<file_catalog> added(batch.size());
+	std::vector<std::string> removed;
+	std::vector<size_t> removed_at; // position in 'batch'
+	for (size_t i = 0; i < batch.size(); ++i) {
+		const folder_event &ev = batch[i];
+		if (ev.type == folder_event_type::removed) {
+			removed.push_back(ev.path);
+			removed_at.push_back(i);
+			continue;
+		}
+		if (ev.is_dir) {
+			scan_dir(ev.path, recursive, added[i], nullptr);
+		} else if (has_media_ext(ev.path)) {
+			media_index_refresh(ev.path);
+			added[i].add_path(ev.path);
+		}
+		request_proxies(data, added[i]);
+	}
+
+	data->file_list.modify([&](file_catalog &v) {
+		// Removed paths may have been directories, so this
+		// drops everything underneath them as well
+		v.remove_under(removed);
+		// Then what was added, unless removed again later
+		for (size_t i = 0; i < batch.size(); ++i) {
+			const file_catalog &a = added[i];
+			for (size_t k = 0; k < a.size(); ++k) {
+				std::string path = a.path(k);
+				bool gone = false;
+				for (size_t r = 0; r < removed.size(); ++r)
+					gone |= removed_at[r] > i &&
+						is_under(path, removed[r]);
+				if (!gone && !v.contains(path))
+					v.add(a.dir(k), a.name(k));
+			}
+		}
+	});
+	// Indices have moved; the order is decided afresh
+	data->select_gen++;
+}
+
+static void stop_watcher(random_media_data *data)
+{
+	for (folder_watcher *w : data->watchers)
+		folder_watcher_destroy(w);
+	data->watchers.clear();
+}
+
+// One watcher per root; a manifest is the whole truth, so
+// nothing is watched then
+static void start_watcher(random_media_data *data)
+{
+	library_config lib = library_of(data);
+	if (!lib.manifest.empty())
+		return;
+
+	for (const std::string &root : lib.roots) {
+		folder_watcher *w = folder_watcher_create(
+			root, lib.recursive,
+			[data](const std::vector<folder_event> &batch) {
+				on_folder_events(data, batch);
+			});
+		if (w)
+			data->watchers.push_back(w);
+		else
+			blog(LOG_WARNING,
+			     "[RandomMedia] Folder watching unavailable"
+			     " for '%s' — use Reload File List",
+			     root.c_str());
+	}
+}
+
+// ============================================================
+//  Background reload
+// ============================================================
+// A full rescan runs on its own thread and publishes the new
+// list in one swap when it finishes, so spawns keep drawing
+// from the previous snapshot meanwhile. Job IDs are unique
+// across instances; starting a job cancels the one running.
+static std::atomic<uint64_t> s_next_reload{0};
+
+static void reload_thread_main(random_media_data *data, uint64_t job,
+			       library_config lib)
+{
+	os_set_thread_name("random-media: reload");
+	file_catalog files;
+	scan_progress progress = {&data->reload_scanned,
+				  &data->reload_cancel};
+	build_catalog(lib, files, &progress);
+	if (data->reload_cancel) {
+		blog(LOG_INFO, "[RandomMedia] Reload %llu cancelled",
+		     (unsigned long long)job);
+		return;
+	}
+	save_snapshot(lib, files);
+	publish_file_list(data, std::move(files), lib);
+	data->reload_done = job;
+	request_lookahead_refill(data);
+}
+
+// Caller holds reload_mutex
+static void cancel_reload_locked(random_media_data *data)
+{
+	if (!data->reload_thread.joinable())
+		return;
+	data->reload_cancel = true;
+	data->reload_thread.join();
+	data->reload_cancel = false;
+}
+
+static void cancel_reload(random_media_data *data)
+{
+	std::lock_guard<std::mutex> lk(data->reload_mutex);
+	cancel_reload_locked(data);
+}
+
+// Returns the new job's ID at once; the scan is of the library
+// as configured now
+static uint64_t start_reload(random_media_data *data)
+{
+	std::lock_guard<std::mutex> lk(data->reload_mutex);
+	cancel_reload_locked(data);
+	uint64_t job = ++s_next_reload;
+	data->reload_scanned = 0;
+	data->reload_job = job;
+	data->reload_thread = std::thread(reload_thread_main, data, job,
+					  library_of(data));
+	return job;
+}
+
+// "done" once published, "running" while it is the current
+// job, "superseded" if a later job replaced it
+static const char *reload_state(random_media_data *data,
+				uint64_t job)
+{
+	if (!job || job > s_next_reload)
+		return "unknown";
+	if (job == data->reload_done)
+		return "done";
+	if (job == data->reload_job)
+		return "running";
+	return "superseded";
+}
+
+// ============================================================
+//  Source pool
+// ============================================================
+// Spawned ffmpeg_sources are private and recycled: a finished
+// item goes back to pool_idle instead of being destroyed, so
+// a burst of triggers reuses already-allocated sources and
+// their filter chains, and only swaps 'local_file'.
+static std::atomic<int> s_uid{0};
+
+// ============================================================
+//  Decode path
+// ============================================================
+// Hardware decoders have a fixed number of sessions shared by
+// the whole machine, so the limit is process-wide. A source
+// holds a session from the update that turns hw_decode on
+// until it is turned off or the source is destroyed — idle
+// pooled sources keep theirs, and are handed back out to
+// clips that want one first.
+static std::mutex s_hw_mutex;
+static std::unordered_set<obs_source_t *> s_hw_sources;
+static int s_hw_limit = 0;
+
+static bool hw_codec(const std::string &codec)
+{
+	static const char *const codecs[] = {
+		"h264", "hevc", "av1", "vp9", "vp8", "mpeg2video",
+	};
+	for (const char *c : codecs)
+		if (codec == c)
+			return true;
+	return false;
+}
+
+static bool wants_hw(const source_config &cfg, const std::string &file)
+{
+	if (cfg.decode == decode_policy::hardware)
+		return true;
+	if (cfg.decode == decode_policy::software)
+		return false;
+	// Unprobed files decode in software until they are probed
+	media_info info;
+	return media_index_lookup(file, info) && hw_codec(info.codec);
+}
+
+static bool hw_holds(obs_source_t *media)
+{
+	std::lock_guard<std::mutex> lk(s_hw_mutex);
+	return s_hw_sources.count(media) != 0;
+}
+
+// Claims or keeps a session for 'media' if 'want' and one is
+// free, frees its session otherwise. True for hardware.
+static bool hw_claim(obs_source_t *media, bool want, bool &fell_back)
+{
+	std::lock_guard<std::mutex> lk(s_hw_mutex);
+	fell_back = false;
+	bool held = s_hw_sources.count(media) != 0;
+	if (!want) {
+		if (held)
+			s_hw_sources.erase(media);
+		return false;
+	}
+	if (held)
+		return true;
+	if ((int)s_hw_sources.size() >= s_hw_limit) {
+		fell_back = true;
+		return false;
+	}
+	s_hw_sources.insert(media);
+	return true;
+}
+
+static void hw_set_limit(int sessions)
+{
+	std::lock_guard<std::mutex> lk(s_hw_mutex);
+	s_hw_limit = std::max(0, sessions);
+}
+
+static void hw_sessions(size_t &used, int &limit)
+{
+	std::lock_guard<std::mutex> lk(s_hw_mutex);
+	used = s_hw_sources.size();
+	limit = s_hw_limit;
+}
+
+// Clips play in ffmpeg_source, stills in the image source
+static bool is_video_source(obs_source_t *src)
+{
+	return strcmp(obs_source_get_id(src), "ffmpeg_source") == 0;
+}
+
+// Drops the caller's reference to a pooled source for good
+static void destroy_media_source(obs_source_t *src)
+{
+	{
+		std::lock_guard<std::mutex> lk(s_hw_mutex);
+		s_hw_sources.erase(src);
+	}
+	obs_source_release(src);
+}
+
+static obs_source_t *create_media_source(void)
+{
+	std::string name = "RMS_" + std::to_string(++s_uid);
+
+	obs_data_t *s = obs_data_create();
+	obs_data_set_bool(s, "is_local_file", true);
+	obs_data_set_bool(s, "restart_on_activate", true);
+	obs_data_set_bool(s, "close_when_inactive", false);
+	obs_data_set_bool(s, "clear_on_media_end", true);
+
+	obs_source_t *media = obs_source_create_private(
+		"ffmpeg_source", name.c_str(), s);
+	obs_data_release(s);
+	return media;
+}
+
+// Returns a new reference, or nullptr if creation failed.
+// Prefers an idle source that already holds a hardware session
+// if 'hw', and one that does not otherwise.
+static obs_source_t *pool_acquire(random_media_data *data, bool hw)
+{
+	{
+		std::lock_guard<std::mutex> lk(data->pool_mutex);
+		auto &idle = data->pool_idle;
+		if (!idle.empty()) {
+			size_t pick = idle.size() - 1;
+			for (size_t i = idle.size(); i > 0; --i)
+				if (hw_holds(idle[i - 1]) == hw) {
+					pick = i - 1;
+					break;
+				}
+			obs_source_t *src = idle[pick];
+			idle.erase(idle.begin() + (ptrdiff_t)pick);
+			data->pool_hits++;
+			return src;
+		}
+	}
+	data->pool_misses++;
+	return create_media_source();
+}
+
+// Takes over the caller's reference. Image sources are cheap
+// to create and are not pooled.
+static void pool_release(random_media_data *data, obs_source_t *src)
+{
+	if (!is_video_source(src)) {
+		obs_source_release(src);
+		return;
+	}
+	{
+		int pool_max = config_of(data).pool_max;
+		std::lock_guard<std::mutex> lk(data->pool_mutex);
+		if ((int)data->pool_idle.size() < pool_max) {
+			data->pool_idle.push_back(src);
+			return;
+		}
+	}
+	destroy_media_source(src);
+}
+
+// Pre-warm up to pool_min, trim down to pool_max
+static void pool_resize(random_media_data *data)
+{
+	std::vector<obs_source_t *> excess;
+	int missing = 0;
+	source_config cfg = config_of(data);
+	{
+		std::lock_guard<std::mutex> lk(data->pool_mutex);
+		int pmax = std::max(0, cfg.pool_max);
+		while ((int)data->pool_idle.size() > pmax) {
+			excess.push_back(data->pool_idle.back());
+			data->pool_idle.pop_back();
+		}
+		int pmin = std::min(cfg.pool_min, pmax);
+		missing = pmin - (int)data->pool_idle.size();
+	}
+	for (obs_source_t *src : excess)
+		destroy_media_source(src);
+
+	for (int i = 0; i < missing; ++i) {
+		obs_source_t *src = create_media_source();
+		if (!src)
+			break;
+		pool_release(data, src);
+	}
+}
+
+static void pool_clear(random_media_data *data)
+{
+	std::vector<obs_source_t *> idle;
+	{
+		std::lock_guard<std::mutex> lk(data->pool_mutex);
+		idle.swap(data->pool_idle);
+	}
+	for (obs_source_t *src : idle)
+		destroy_media_source(src);
+}
+
+// ============================================================
+//  Lookahead
+// ============================================================
+// The next N selections are decided ahead of time and loaded
+// into inactive pooled sources, so ffmpeg_source opens the
+// demuxer and decoder before the trigger arrives. A trigger
+// then only has to add the source to the scene.
+static void set_local_file(obs_source_t *media, const std::string &file,
+			   bool hw_decode)
+{
+	obs_data_t *s = obs_data_create();
+	obs_data_set_string(s, "local_file", file.c_str());
+	obs_data_set_bool(s, "hw_decode", hw_decode);
+	obs_source_update(media, s);
+	obs_data_release(s);
+}
+
+// Updating with the same file keeps the cached texture, so
+// this also refreshes the duration of a lookahead image
+static void set_image_file(obs_source_t *image, const std::string &file,
+			   float duration)
+{
+	obs_data_t *s = obs_data_create();
+	obs_data_set_string(s, "file", file.c_str());
+	obs_data_set_double(s, "duration", duration);
+	obs_source_update(image, s);
+	obs_data_release(s);
+}
+
+// Returns a new reference with 'file' loaded, or nullptr. A
+// ready proxy is loaded in place of an oversized clip, and its
+// size returned in width/height; both are 0 otherwise. The
+// decode path follows the policy while hardware sessions last.
+static obs_source_t *open_media(random_media_data *data,
+				const source_config &cfg,
+				const std::string &file, uint32_t &width,
+				uint32_t &height)
+{
+	width = height = 0;
+	if (is_still_image(file)) {
+		std::string name = "RMS_IMG_" + std::to_string(++s_uid);
+		obs_source_t *img = obs_source_create_private(
+			IMAGE_SOURCE_ID, name.c_str(), nullptr);
+		if (img)
+			set_image_file(img, file, cfg.image_duration);
+		return img;
+	}
+	proxy_info proxy;
+	uint32_t box_w, box_h;
+	proxy_box(cfg, box_w, box_h);
+	bool use_proxy = cfg.use_proxies && box_w &&
+			 proxy_cache_lookup(file, box_w, box_h, proxy);
+	const std::string &path = use_proxy ? proxy.path : file;
+
+	bool want = wants_hw(cfg, path);
+	obs_source_t *media = pool_acquire(data, want);
+	if (!media)
+		return nullptr;
+
+	bool fell_back;
+	bool hw = hw_claim(media, want, fell_back);
+	if (fell_back) {
+		data->hw_fallbacks++;
+		if (cfg.verbose_log)
+			blog(LOG_INFO,
+			     "[RandomMedia] Hardware decode sessions in"
+			     " use — software for %s",
+			     path.c_str());
+	}
+	(hw ? data->opened_hw : data->opened_sw)++;
+	set_local_file(media, path, hw);
+	if (use_proxy) {
+		width = proxy.width;
+		height = proxy.height;
+	}
+	return media;
+}
+
+// Runs on the spawn worker while it is idle
+static void lookahead_fill(random_media_data *data)
+{
+	source_config cfg = config_of(data);
+	size_t want = (size_t)std::max(0, cfg.lookahead);
+	size_t have;
+	std::vector<obs_source_t *> excess;
+	{
+		std::lock_guard<std::mutex> lk(data->lookahead_mutex);
+		auto &q = data->lookahead_queue;
+		while (q.size() > want) {
+			excess.push_back(q.back().source);
+			q.pop_back();
+		}
+		have = q.size();
+	}
+	for (obs_source_t *src : excess)
+		pool_release(data, src);
+	if (have >= want)
+		return;
+
+	std::vector<std::string> picks;
+	pick_files(data, want - have, picks);
+	for (std::string &file : picks) {
+		uint32_t w, h;
+		obs_source_t *media = open_media(data, cfg, file, w, h);
+		if (!media)
+			break;
+
+		std::lock_guard<std::mutex> lk(data->lookahead_mutex);
+		data->lookahead_queue.push_back(
+			{std::move(file), media, w, h});
+	}
+}
+
+static std::vector<lookahead_entry>
+lookahead_take(random_media_data *data, size_t count)
+{
+	std::vector<lookahead_entry> out;
+	std::lock_guard<std::mutex> lk(data->lookahead_mutex);
+	while (out.size() < count && !data->lookahead_queue.empty()) {
+		out.push_back(std::move(data->lookahead_queue.front()));
+		data->lookahead_queue.pop_front();
+	}
+	return out;
+}
+
+// Returns prepared sources to the pool, e.g. on folder change
+static void lookahead_flush(random_media_data *data)
+{
+	std::deque<lookahead_entry> q;
+	{
+		std::lock_guard<std::mutex> lk(data->lookahead_mutex);
+		q.swap(data->lookahead_queue);
+	}
+	for (lookahead_entry &e : q)
+		pool_release(data, e.source);
+}
+
+// ============================================================
+//  Resource budget
+// ============================================================
+// Each item is charged an estimate of what it holds while
+// live, from the media index: decoded surfaces, textures and
+// decode rate. Spawns charge before opening anything and the
+// charge is refunded when the item retires.
+
+// Surfaces a decoder keeps per stream: references plus the
+// frames libobs buffers for async video
+static uint64_t decode_surfaces(const std::string &codec)
+{
+	static const struct {
+		const char *codec;
+		uint64_t surfaces;
+	} table[] = {
+		{"h264", 20}, {"hevc", 20}, {"av1", 14}, {"vp9", 14},
+		{"vp8", 8},   {"gif", 6},   {"mjpeg", 6}, {"png", 6},
+	};
+	for (const auto &e : table)
+		if (codec == e.codec)
+			return e.surfaces;
+	return 12;
+}
+
+static resource_cost estimate_cost(const source_config &cfg,
+				   const std::string &file)
+{
+	media_info info;
+	bool known = media_index_lookup(file, info);
+	uint64_t w = known ? info.width : 0;
+	uint64_t h = known ? info.height : 0;
+
+	uint32_t box_w, box_h;
+	proxy_info proxy;
+	proxy_box(cfg, box_w, box_h);
+	if (cfg.use_proxies && box_w &&
+	    proxy_cache_lookup(file, box_w, box_h, proxy)) {
+		w = proxy.width;
+		h = proxy.height;
+	}
+	// Unprobed files are assumed to be 1080p
+	if (!w || !h) {
+		w = 1920;
+		h = 1080;
+	}
+	uint64_t px = w * h;
+
+	resource_cost c;
+	if (is_still_image(file)) {
+		c.vram_bytes = px * 4; // one RGBA texture
+		return c;
+	}
+	double fps = known && info.fps > 0.0 ? info.fps : 30.0;
+	c.decoder_bytes = px * 3 / 2 * decode_surfaces(info.codec);
+	// YUV planes plus the RGBA conversion target
+	c.vram_bytes = px * 3 / 2 + px * 4;
+	c.pixels_per_sec = (uint64_t)((double)px * fps);
+	return c;
+}
+
+static bool within(uint64_t used, uint64_t add, uint64_t limit)
+{
+	return !limit || used + add <= limit;
+}
+
+// Reserves 'cost' if it fits. With nothing live anything fits,
+// so one oversized file cannot wait forever.
+static bool budget_charge(random_media_data *data,
+			  const source_config &cfg,
+			  const resource_cost &cost)
+{
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	resource_cost &u = data->usage;
+	bool empty = !u.decoder_bytes && !u.vram_bytes &&
+		     !u.pixels_per_sec;
+	if (!empty &&
+	    (!within(u.decoder_bytes, cost.decoder_bytes,
+		     cfg.budget_decoder) ||
+	     !within(u.vram_bytes, cost.vram_bytes, cfg.budget_vram) ||
+	     !within(u.pixels_per_sec, cost.pixels_per_sec,
+		     cfg.budget_pps)))
+		return false;
+	u += cost;
+	return true;
+}
+
+// Wakes the spawn worker if requests wait on the budget
+static void budget_refund(random_media_data *data,
+			  const resource_cost &cost)
+{
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		data->usage -= cost;
+	}
+	// Set even with nobody waiting, for a request that is
+	// being deferred right now
+	bool notify;
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		notify = !data->budget_wait.empty();
+		data->budget_freed = true;
+	}
+	if (notify)
+		data->queue_cv.notify_one();
+}
+
+// Charges 'file' against the budget, applying the policy if it
+// does not fit: 'file' may be swapped for a cheaper random pick
+// (only if 'can_replace'), or appended to 'deferred' to retry
+// once items retire. Without 'deferred' a queued item drops.
+static bool budget_admit(random_media_data *data,
+			 const source_config &cfg, std::string &file, bool can_replace,
+			 resource_cost &cost,
+			 std::vector<std::string> *deferred)
+{
+	cost = estimate_cost(cfg, file);
+	if (budget_charge(data, cfg, cost))
+		return true;
+
+	if (cfg.policy == budget_policy::replace && can_replace) {
+		std::vector<std::string> picks;
+		sample_files(data, BUDGET_REPLACE_TRIES, picks);
+		std::string best;
+		resource_cost best_cost;
+		for (const std::string &f : picks) {
+			resource_cost c = estimate_cost(cfg, f);
+			if (best.empty() ||
+			    c.pixels_per_sec + c.vram_bytes <
+				    best_cost.pixels_per_sec +
+					    best_cost.vram_bytes) {
+				best = f;
+				best_cost = c;
+			}
+		}
+		if (!best.empty() && budget_charge(data, cfg, best_cost)) {
+			file = best;
+			cost = best_cost;
+			data->budget_replaced++;
+			return true;
+		}
+	} else if (cfg.policy == budget_policy::queue && deferred) {
+		deferred->push_back(file);
+		data->budget_deferred++;
+		return false;
+	}
+	if (cfg.verbose_log)
+		blog(LOG_INFO, "[RandomMedia] Over budget — drop %s",
+		     file.c_str());
+	trace_record(trace_event::skip, 0);
+	data->budget_dropped++;
+	data->dropped++;
+	return false;
+}
+
+// ============================================================
+//  Item lifetime
+// ============================================================
+// Every spawned item stays in 'live' until it is retired: by
+// media_ended, by its max lifetime running out in the timer
+// wheel, by despawn, or by source_destroy. Whoever takes an
+// item out of 'live' owns its teardown, so the paths never
+// race. The slot is reserved (holding nullptr) before any
+// signal is connected and filled in by track_item().
+struct item_ctx {
+	random_media_data *data;
+	uint64_t id;                 // slot handle
+	obs_sceneitem_t *item;       // own reference, or nullptr
+	obs_source_t *media_source;  // own reference
+	bool on_bus;
+	bool composited;             // in comp_items, not a scene
+	bool hide_on_end;            // media_ended is connected
+
+	// Trigger-to-playback time, split by whether the spawn
+	// used a pre-opened lookahead source. 'spawn_ns' is taken
+	// just before obs_scene_add, which activates the source.
+	uint64_t trigger_ns;
+	uint64_t spawn_ns;
+	bool lookahead_hit;
+	std::atomic<bool> started{false};
+	resource_cost cost; // refunded on retirement
+	uint64_t place_id;  // box in 'placed', 0 if none
+	bool hw_decode;     // counted in live_hw, else live_sw
+};
+
+static void count_decode_out(random_media_data *data,
+			     const item_ctx *ctx)
+{
+	if (is_video_source(ctx->media_source))
+		(ctx->hw_decode ? data->live_hw : data->live_sw)--;
+}
+
+static void on_media_started(void *param, calldata_t * /*cd*/)
+{
+	auto *ctx = static_cast<item_ctx *>(param);
+	if (ctx->started.exchange(true))
+		return;
+	uint64_t now = os_gettime_ns();
+	trace_record_at(trace_event::first_frame, ctx->id, now);
+	latency_histogram &h = ctx->lookahead_hit
+				       ? ctx->data->start_hit
+				       : ctx->data->start_miss;
+	h.record(now - ctx->trigger_ns);
+	ctx->data->stages[STAGE_FIRST_FRAME].record(now -
+						    ctx->spawn_ns);
+}
+
+static void on_media_ended(void *param, calldata_t *cd);
+
+static void remove_items_cb(void *param, obs_scene_t *scene)
+{
+	auto *items = static_cast<std::vector<item_ctx *> *>(param);
+	for (item_ctx *ctx : *items)
+		if (ctx->item &&
+		    obs_sceneitem_get_scene(ctx->item) == scene)
+			obs_sceneitem_remove(ctx->item);
+}
+
+// Frees the placement boxes of retired or failed items
+static void release_places(random_media_data *data,
+			   const std::vector<uint64_t> &ids)
+{
+	if (ids.empty())
+		return;
+	std::lock_guard<std::mutex> lk(data->place_mutex);
+	for (uint64_t id : ids)
+		data->placed.remove(id);
+}
+
+// Tears down items already taken out of 'live'. Must not be
+// called with active_mutex held: disconnecting waits for
+// in-flight signal callbacks, which take that mutex.
+static void retire_items(random_media_data *data,
+			 std::vector<item_ctx *> &items)
+{
+	// Once disconnected, no callback can still use a ctx
+	for (item_ctx *ctx : items) {
+		signal_handler_t *sh =
+			obs_source_get_signal_handler(ctx->media_source);
+		signal_handler_disconnect(sh, "media_started",
+					  on_media_started, ctx);
+		if (ctx->hide_on_end)
+			signal_handler_disconnect(sh, "media_ended",
+						  on_media_ended, ctx);
+	}
+
+	// One atomic update per scene — items may have been
+	// spawned into different scenes
+	std::vector<obs_scene_t *> scenes;
+	bool composited = false;
+	for (item_ctx *ctx : items) {
+		composited |= ctx->composited;
+		if (!ctx->item)
+			continue;
+		obs_scene_t *scene = obs_sceneitem_get_scene(ctx->item);
+		if (scene && std::find(scenes.begin(), scenes.end(),
+				       scene) == scenes.end())
+			scenes.push_back(scene);
+	}
+	for (obs_scene_t *scene : scenes)
+		obs_scene_atomic_update(scene, remove_items_cb, &items);
+
+	// Likewise one pass over comp_items for the whole batch
+	if (composited) {
+		std::lock_guard<std::mutex> lk(data->comp_mutex);
+		auto &ci = data->comp_items;
+		ci.erase(std::remove_if(ci.begin(), ci.end(),
+					[&](const comp_item &c) {
+						for (item_ctx *ctx : items)
+							if (ctx->composited &&
+							    ctx->media_source ==
+								    c.media)
+								return true;
+						return false;
+					}),
+			 ci.end());
+	}
+
+	resource_cost freed;
+	std::vector<uint64_t> places;
+	for (item_ctx *ctx : items) {
+		trace_record(trace_event::release, ctx->id);
+		freed += ctx->cost;
+		if (ctx->place_id)
+			places.push_back(ctx->place_id);
+		if (ctx->composited)
+			obs_source_remove_active_child(
+				data->source, ctx->media_source);
+		if (ctx->item)
+			obs_sceneitem_release(ctx->item);
+		if (ctx->on_bus)
+			audio_bus_detach(data->bus, ctx->media_source);
+		count_decode_out(data, ctx);
+		pool_release(data, ctx->media_source);
+		delete ctx;
+	}
+	if (!items.empty())
+		budget_refund(data, freed);
+	release_places(data, places);
+	items.clear();
+}
+
+// Caller holds active_mutex. nullptr if 'id' is stale or the
+// item is not tracked yet.
+static item_ctx *take_live(random_media_data *data, uint64_t id)
+{
+	item_ctx **slot = data->live.find(id);
+	if (!slot || !*slot)
+		return nullptr;
+	item_ctx *ctx = *slot;
+	data->live.take(id, ctx);
+	return ctx;
+}
+
+static void on_media_ended(void *param, calldata_t * /*cd*/)
+{
+	auto *ctx = static_cast<item_ctx *>(param);
+	random_media_data *data = ctx->data;
+	trace_record(trace_event::end, ctx->id);
+	{
+		// Not tracked yet: left to the lifetime timer
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		if (take_live(data, ctx->id) != ctx)
+			return;
+	}
+	std::vector<item_ctx *> one = {ctx};
+	retire_items(data, one);
+	if (config_of(data).verbose_log)
+		blog(LOG_INFO,
+		     "[RandomMedia] Media ended — item removed");
+}
+
+// Returns the new handle, or 0 if the table is full
+// The slot now counts in 'live', so it stops counting in the
+// batch's max_active reservation ('held') in the same step
+static uint64_t reserve_item(random_media_data *data, int *held)
+{
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	uint64_t id = data->live.insert(nullptr);
+	if (id && *held > 0) {
+		(*held)--;
+		data->reserved--;
+	}
+	return id;
+}
+
+static void unreserve_item(random_media_data *data, uint64_t id)
+{
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	item_ctx *unused;
+	data->live.take(id, unused);
+}
+
+// Takes over 'ctx' into its reserved slot; starts its
+// max-lifetime timer
+static void track_item(random_media_data *data, item_ctx *ctx)
+{
+	uint64_t deadline =
+		os_gettime_ns() +
+		(uint64_t)config_of(data).max_lifetime * 1000000000ULL;
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	*data->live.find(ctx->id) = ctx;
+	data->lifetimes.schedule(ctx->id, deadline);
+}
+
+// Runs every frame on the video thread. Only one wheel slot is
+// visited per elapsed LIFETIME_RESOLUTION_NS, however many
+// items are live.
+static void lifetime_tick(void *param, float /*seconds*/)
+{
+	auto *data = static_cast<random_media_data *>(param);
+	std::vector<item_ctx *> due;
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		std::vector<uint64_t> &ids = data->expired_ids;
+		data->lifetimes.advance(os_gettime_ns(), ids);
+		for (uint64_t id : ids) {
+			// Stale handles ended normally
+			if (item_ctx *ctx = take_live(data, id))
+				due.push_back(ctx);
+		}
+		ids.clear();
+	}
+	if (due.empty())
+		return;
+	if (config_of(data).verbose_log)
+		blog(LOG_INFO,
+		     "[RandomMedia] %zu item(s) reached max lifetime"
+		     " — removed",
+		     due.size());
+	retire_items(data, due);
+}
+
+// Batch teardown of everything on screen; items still being
+// committed by a spawn keep their reserved slots. Returns the
+// number of items removed.
+static size_t retire_all(random_media_data *data)
+{
+	std::vector<item_ctx *> items;
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		data->live.take_if(
+			[](item_ctx *ctx) { return ctx != nullptr; },
+			items);
+	}
+	size_t n = items.size();
+	if (n) {
+		blog(LOG_INFO,
+		     "[RandomMedia] Removing %zu active item(s)", n);
+		retire_items(data, items);
+	}
+	return n;
+}
+
+// Returns false if 'id' is not a live item
+static bool retire_one(random_media_data *data, uint64_t id)
+{
+	item_ctx *ctx;
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		ctx = take_live(data, id);
+	}
+	if (!ctx)
+		return false;
+	std::vector<item_ctx *> one = {ctx};
+	retire_items(data, one);
+	return true;
+}
+
+// ============================================================
+//  Audio filters: compressor + limiter
+// ============================================================
+// Pooled sources keep their filters, so existing ones are
+// updated in place and disabled ones are taken off again.
+static void sync_filter(obs_source_t *src, const char *id,
+			const char *name, bool enabled,
+			obs_data_t *settings)
+{
+	obs_source_t *f = obs_source_get_filter_by_name(src, name);
+	if (f) {
+		if (enabled)
+			obs_source_update(f, settings);
+		else
+			obs_source_filter_remove(src, f);
+		obs_source_release(f);
+		return;
+	}
+	if (!enabled)
+		return;
+	f = obs_source_create_private(id, name, settings);
+	if (f) {
+		obs_source_filter_add(src, f);
+		obs_source_release(f);
+	}
+}
+
+static void apply_audio_filters(obs_source_t *src,
+				const source_config &cfg, bool enable)
+{
+	// ---- Compressor ----
+	obs_data_t *cs = obs_data_create();
+	obs_data_set_double(cs, "threshold", cfg.comp_threshold);
+	obs_data_set_double(cs, "ratio", cfg.comp_ratio);
+	obs_data_set_double(cs, "attack_time", cfg.comp_attack);
+	obs_data_set_double(cs, "release_time", cfg.comp_release);
+	obs_data_set_double(cs, "output_gain",
+			    cfg.comp_output_gain);
+	sync_filter(src, "compressor_filter", "RMS_Compressor",
+		    enable && cfg.use_compressor, cs);
+	obs_data_release(cs);
+
+	// ---- Limiter ----
+	obs_data_t *ls = obs_data_create();
+	obs_data_set_double(ls, "threshold",
+			    cfg.limiter_threshold);
+	obs_data_set_double(ls, "release_time", 60.0);
+	sync_filter(src, "limiter_filter", "RMS_Limiter",
+		    enable && cfg.use_limiter, ls);
+	obs_data_release(ls);
+}
+
+// Gain in dB that brings 'file' to the target loudness, with
+// the volume setting as a trim on top. Capped so the true peak
+// stays under the limiter ceiling, which is no longer running.
+static bool normalize_gain(const source_config &cfg,
+			   const std::string &file, float &gain_db)
+{
+	media_info info;
+	if (!media_index_lookup(file, info) || !info.loudness_valid)
+		return false;
+	double gain = cfg.target_lufs - info.loudness +
+		      cfg.volume_db;
+	gain = std::min(gain,
+			(double)cfg.limiter_threshold - info.true_peak);
+	gain_db = (float)gain;
+	return true;
+}
+
+// ============================================================
+//  Spawn
+// ============================================================
+// A batch is built in two passes: every source is acquired and
+// configured first, then all items are added and placed inside
+// one obs_scene_atomic_update, so the scene lock is taken once
+// and no frame renders a partial batch.
+struct prepared_item {
+	std::string file;
+	std::string name;
+	obs_source_t *media;
+	float vol_linear;
+	bool on_bus;
+	bool lookahead_hit;
+	uint32_t width;  // proxy size, 0 if the file itself plays
+	uint32_t height;
+	resource_cost cost; // charged to the budget
+	uint64_t create_ns; // prepare_item started
+	item_transform xf;  // from place_batch
+	uint64_t place_id;  // its box, 0 if not tracked
+	obs_sceneitem_t *item;
+	uint64_t handle;
+};
+
+// 'prepared' is a lookahead entry that already has 'file'
+// loaded; its source reference is taken over
+static bool prepare_item(random_media_data *data,
+			 const source_config &cfg,
+			 const std::string &file,
+			 const lookahead_entry *prepared,
+			 prepared_item &out)
+{
+	latency_histogram *st = data->stages;
+	uint64_t start_ns = os_gettime_ns();
+	uint64_t t0 = start_ns;
+	uint64_t t1;
+
+	bool still = is_still_image(file);
+	uint32_t width = prepared ? prepared->width : 0;
+	uint32_t height = prepared ? prepared->height : 0;
+	obs_source_t *media = prepared ? prepared->source
+				       : open_media(data, cfg, file, width,
+						    height);
+	if (!media) {
+		blog(LOG_ERROR,
+		     "[RandomMedia] Failed to create source: %s",
+		     file.c_str());
+		return false;
+	}
+	if (prepared && still)
+		set_image_file(media, file, cfg.image_duration);
+	t1 = os_gettime_ns();
+	st[STAGE_CREATE].record(t1 - t0);
+	t0 = t1;
+
+	// Set volume: convert dB to linear (0 dB = 1.0)
+	float vol_linear = obs_db_to_mul(cfg.volume_db);
+	bool on_bus = !still && cfg.use_audio_bus && data->bus;
+	bool normalized = false;
+
+	// Stills have no audio to set up
+	if (on_bus) {
+		// Heard only through the bus, which applies the
+		// volume and runs the shared filter chain
+		obs_source_set_muted(media, true);
+		obs_source_set_monitoring_type(
+			media, OBS_MONITORING_TYPE_NONE);
+	} else if (!still) {
+		float gain_db;
+		if (cfg.normalize_audio) {
+			normalized = normalize_gain(cfg, file, gain_db);
+			if (normalized) {
+				vol_linear = obs_db_to_mul(gain_db);
+				data->normalized++;
+			} else {
+				data->normalize_fallbacks++;
+			}
+		}
+		obs_source_set_muted(media, false);
+		obs_source_set_volume(media, vol_linear);
+
+		// Monitor + Output so streamer can hear it
+		obs_source_set_monitoring_type(
+			media, OBS_MONITORING_TYPE_MONITOR_AND_OUTPUT);
+	}
+	t1 = os_gettime_ns();
+	st[STAGE_SETUP].record(t1 - t0);
+	t0 = t1;
+
+	// Compressor + Limiter filters; on the bus they run once
+	// on the mix instead, and normalized items need none
+	if (!still)
+		apply_audio_filters(media, cfg, !on_bus && !normalized);
+	st[STAGE_FILTERS].record(os_gettime_ns() - t0);
+
+	out.file = file;
+	out.name = obs_source_get_name(media);
+	out.media = media;
+	out.vol_linear = vol_linear;
+	out.on_bus = on_bus;
+	out.lookahead_hit = prepared != nullptr;
+	out.width = width;
+	out.height = height;
+	out.create_ns = start_ns;
+	out.xf = {{0.0f, 0.0f}, {1.0f, 1.0f}, 0.0f};
+	out.place_id = 0;
+	out.item = nullptr;
+	out.handle = 0;
+	return true;
+}
+
+// Source natural size — the decoder has not produced a frame
+// yet, so prefer the probed size
+static void source_size(const prepared_item &p, float cw, float ch,
+			float &w, float &h)
+{
+	media_info info;
+	if (p.width && p.height) {
+		w = (float)p.width;
+		h = (float)p.height;
+	} else if (media_index_lookup(p.file, info)) {
+		w = (float)info.width;
+		h = (float)info.height;
+	} else {
+		w = (float)obs_source_get_width(p.media);
+		h = (float)obs_source_get_height(p.media);
+	}
+	if (w < 1.0f)
+		w = cw * 0.3f;
+	if (h < 1.0f)
+		h = ch * 0.3f;
+}
+
+static item_transform random_transform(const source_config &cfg,
+				       const prepared_item &p,
+				       std::mt19937 &gen)
+{
+	item_transform xf = {{0.0f, 0.0f}, {1.0f, 1.0f}, 0.0f};
+	if (!cfg.do_random_transform)
+		return xf;
+
+	struct obs_video_info ovi = {};
+	obs_get_video_info(&ovi);
+	float cw = (float)ovi.base_width;
+	float ch = (float)ovi.base_height;
+
+	float smin = cfg.min_scale / 100.0f;
+	float smax = cfg.max_scale / 100.0f;
+	if (smin > smax)
+		std::swap(smin, smax);
+
+	std::uniform_real_distribution<float> ds(smin, smax);
+	float sx = ds(gen) * cw;
+
+	float src_w, src_h;
+	source_size(p, cw, ch, src_w, src_h);
+
+	float scale_x = sx / src_w;
+	float scale_y = cfg.preserve_aspect
+				? scale_x
+				: (ds(gen) * ch / src_h);
+
+	float item_w = src_w * scale_x;
+	float item_h = src_h * scale_y;
+
+	// Keep fully inside canvas
+	float max_x = std::max(0.0f, cw - item_w);
+	float max_y = std::max(0.0f, ch - item_h);
+
+	std::uniform_real_distribution<float> dx(0.0f, max_x);
+	std::uniform_real_distribution<float> dy(0.0f, max_y);
+
+	xf.pos = {dx(gen), dy(gen)};
+	xf.scale = {scale_x, scale_y};
+
+	if (!cfg.disable_rot) {
+		float rmin = cfg.min_rot;
+		float rmax = cfg.max_rot;
+		if (rmin > rmax)
+			std::swap(rmin, rmax);
+		std::uniform_real_distribution<float> dr(rmin, rmax);
+		xf.rot = dr(gen);
+	}
+	return xf;
+}
+
+// Bounds of the item rotated about its top-left corner,
+// relative to its position
+static aabb rotated_bounds(float w, float h, float rot)
+{
+	float r = RAD(rot);
+	float c = cosf(r), s = sinf(r);
+	float xs[4] = {0.0f, w * c, -h * s, w * c - h * s};
+	float ys[4] = {0.0f, w * s, h * c, w * s + h * c};
+	return {*std::min_element(xs, xs + 4),
+		*std::min_element(ys, ys + 4),
+		*std::max_element(xs, xs + 4),
+		*std::max_element(ys, ys + 4)};
+}
+
+// Mean item width, as the grid's cell size
+static float placement_cell(const source_config &cfg, float cw)
+{
+	return (cfg.min_scale + cfg.max_scale) / 200.0f * cw;
+}
+
+// Transforms for the whole batch in one pass. In spread mode
+// every item is moved to a spot, rotation included, that no
+// live item or earlier batch member covers; at most PLACE_TRIES
+// hash lookups each, then it overlaps.
+static void place_batch(random_media_data *data,
+			const source_config &cfg,
+			std::vector<prepared_item> &items,
+			std::mt19937 &gen)
+{
+	latency_histogram &st = data->stages[STAGE_TRANSFORM];
+	if (!cfg.spread_placement || !cfg.do_random_transform) {
+		for (prepared_item &p : items) {
+			uint64_t t0 = os_gettime_ns();
+			p.xf = random_transform(cfg, p, gen);
+			st.record(os_gettime_ns() - t0);
+		}
+		return;
+	}
+
+	struct obs_video_info ovi = {};
+	obs_get_video_info(&ovi);
+	float cw = (float)ovi.base_width;
+	float ch = (float)ovi.base_height;
+
+	std::lock_guard<std::mutex> lk(data->place_mutex);
+	float cell = placement_cell(cfg, cw);
+	float have = data->placed.cell_size();
+	if (cell > have * 2.0f || cell < have * 0.5f)
+		data->placed.resize(cell);
+
+	for (prepared_item &p : items) {
+		uint64_t t0 = os_gettime_ns();
+		p.xf = random_transform(cfg, p, gen);
+
+		float w, h;
+		source_size(p, cw, ch, w, h);
+		aabb rel = rotated_bounds(w * p.xf.scale.x,
+					  h * p.xf.scale.y, p.xf.rot);
+
+		// Keep the rotated box on canvas where it fits
+		float x_lo = -rel.x0;
+		float y_lo = -rel.y0;
+		float x_hi = std::max(x_lo, cw - rel.x1);
+		float y_hi = std::max(y_lo, ch - rel.y1);
+		std::uniform_real_distribution<float> dx(x_lo, x_hi);
+		std::uniform_real_distribution<float> dy(y_lo, y_hi);
+
+		aabb box = {};
+		bool free_spot = false;
+		for (int i = 0; i < PLACE_TRIES && !free_spot; ++i) {
+			p.xf.pos = {dx(gen), dy(gen)};
+			box = {p.xf.pos.x + rel.x0, p.xf.pos.y + rel.y0,
+			       p.xf.pos.x + rel.x1, p.xf.pos.y + rel.y1};
+			free_spot = !data->placed.overlaps(box);
+		}
+		if (!free_spot)
+			data->place_overlaps++;
+
+		p.place_id = ++data->next_place_id;
+		data->placed.insert(p.place_id, box);
+		st.record(os_gettime_ns() - t0);
+	}
+}
+
+// Reserves the item's slot out of the batch's 'held' slots and
+// starts first-frame timing; nullptr if the item table is full
+static item_ctx *begin_item(random_media_data *data,
+			    const source_config &cfg,
+			    const prepared_item &p, int *held,
+			    uint64_t trigger_ns, bool composited)
+{
+	uint64_t id = reserve_item(data, held);
+	if (!id) {
+		blog(LOG_WARNING, "[RandomMedia] Item table full");
+		return nullptr;
+	}
+	auto *ctx = new item_ctx();
+	ctx->data = data;
+	ctx->id = id;
+	ctx->media_source = p.media;
+	ctx->on_bus = p.on_bus;
+	ctx->hide_on_end = cfg.hide_on_end;
+	ctx->composited = composited;
+	ctx->trigger_ns = trigger_ns;
+	ctx->spawn_ns = os_gettime_ns();
+	ctx->lookahead_hit = p.lookahead_hit;
+	ctx->cost = p.cost;
+	ctx->place_id = p.place_id;
+	ctx->hw_decode = hw_holds(p.media);
+	if (is_video_source(p.media))
+		(ctx->hw_decode ? data->live_hw : data->live_sw)++;
+	trace_record_at(trace_event::create, id, p.create_ns);
+	signal_handler_connect(obs_source_get_signal_handler(p.media),
+			       "media_started", on_media_started, ctx);
+	return ctx;
+}
+
+static void abort_item(random_media_data *data, item_ctx *ctx)
+{
+	signal_handler_disconnect(
+		obs_source_get_signal_handler(ctx->media_source),
+		"media_started", on_media_started, ctx);
+	unreserve_item(data, ctx->id);
+	count_decode_out(data, ctx);
+	delete ctx;
+}
+
+// Our source reference goes to the item_ctx, which hands it
+// back to the pool on retirement. Once tracked the item may be
+// retired at any time, so nothing past this touches p.item or
+// p.media.
+static void finish_item(random_media_data *data, prepared_item &p,
+			item_ctx *ctx)
+{
+	if (ctx->hide_on_end)
+		signal_handler_connect(
+			obs_source_get_signal_handler(p.media),
+			"media_ended", on_media_ended, ctx);
+	track_item(data, ctx);
+	p.handle = ctx->id;
+}
+
+struct batch_ctx {
+	random_media_data *data;
+	const source_config *cfg;
+	std::vector<prepared_item> *items;
+	int *reserved; // the batch's max_active slots
+	uint64_t trigger_ns;
+};
+
+// Runs under the scene lock: only scene edits and signal
+// hookups here, logging and cleanup happen afterwards
+static void commit_batch(void *param, obs_scene_t *scene)
+{
+	auto *b = static_cast<batch_ctx *>(param);
+	random_media_data *data = b->data;
+	latency_histogram *st = data->stages;
+
+	for (prepared_item &p : *b->items) {
+		item_ctx *ctx = begin_item(data, *b->cfg, p, b->reserved,
+					   b->trigger_ns, false);
+		if (!ctx)
+			continue;
+		uint64_t t0 = ctx->spawn_ns;
+
+		p.item = obs_scene_add(scene, p.media);
+		if (!p.item) {
+			abort_item(data, ctx);
+			continue;
+		}
+		obs_sceneitem_set_visible(p.item, true);
+		if (p.on_bus)
+			audio_bus_attach(data->bus, p.media,
+					 p.vol_linear);
+		st[STAGE_SCENE_ADD].record(os_gettime_ns() - t0);
+		trace_record(trace_event::scene_add, ctx->id);
+
+		obs_sceneitem_set_pos(p.item, &p.xf.pos);
+		obs_sceneitem_set_scale(p.item, &p.xf.scale);
+		obs_sceneitem_set_rot(p.item, p.xf.rot);
+
+		obs_sceneitem_addref(p.item);
+		ctx->item = p.item;
+		finish_item(data, p, ctx);
+	}
+}
+
+// Compositor mode: items are not scene items, just entries in
+// comp_items drawn by source_video_render. The whole batch is
+// published under one lock, so no frame shows part of it.
+static void commit_composited(random_media_data *data,
+			      const source_config &cfg,
+			      std::vector<prepared_item> &items,
+			      int *reserved, uint64_t trigger_ns)
+{
+	latency_histogram *st = data->stages;
+	std::vector<item_ctx *> ctxs(items.size(), nullptr);
+	std::vector<comp_item> batch;
+	batch.reserve(items.size());
+
+	for (size_t i = 0; i < items.size(); ++i) {
+		prepared_item &p = items[i];
+		item_ctx *ctx = begin_item(data, cfg, p, reserved,
+					   trigger_ns, true);
+		if (!ctx)
+			continue;
+		batch.push_back({p.media, p.xf});
+		ctxs[i] = ctx;
+	}
+
+	uint64_t t0 = os_gettime_ns();
+	for (size_t i = 0; i < items.size(); ++i) {
+		if (!ctxs[i])
+			continue;
+		obs_source_add_active_child(data->source, items[i].media);
+		if (items[i].on_bus)
+			audio_bus_attach(data->bus, items[i].media,
+					 items[i].vol_linear);
+	}
+	{
+		std::lock_guard<std::mutex> lk(data->comp_mutex);
+		data->comp_items.insert(data->comp_items.end(),
+					batch.begin(), batch.end());
+	}
+	for (item_ctx *ctx : ctxs)
+		if (ctx)
+			trace_record(trace_event::scene_add, ctx->id);
+	if (!batch.empty())
+		st[STAGE_SCENE_ADD].record((os_gettime_ns() - t0) /
+					   batch.size());
+
+	for (size_t i = 0; i < items.size(); ++i)
+		if (ctxs[i])
+			finish_item(data, items[i], ctxs[i]);
+}
+
+// Explicit names may be absolute or relative to any root
+static bool resolve_file(random_media_data *data,
+			 const std::string &name, std::string &out)
+{
+	// URLs only ever play from the cache
+	if (remote_is_url(name)) {
+		if (remote_cache_lookup(name, out))
+			return true;
+		remote_cache_request(name);
+		blog(LOG_WARNING,
+		     "[RandomMedia] Not cached yet, downloading: %s",
+		     name.c_str());
+		return false;
+	}
+	if (os_file_exists(name.c_str())) {
+		out = name;
+		return true;
+	}
+	for (const std::string &root : library_of(data).roots) {
+		std::string path = root + "/" + name;
+		if (os_file_exists(path.c_str())) {
+			out = path;
+			return true;
+		}
+	}
+	blog(LOG_WARNING, "[RandomMedia] File not found: %s",
+	     name.c_str());
+	return false;
+}
+
+// Charges the budget for 'file' and prepares it, refunding the
+// charge if the source cannot be set up
+static void admit_item(random_media_data *data,
+		       const source_config &cfg, std::string file,
+		       bool can_replace,
+		       const lookahead_entry *prepared,
+		       std::vector<prepared_item> &items,
+		       std::vector<std::string> *deferred)
+{
+	resource_cost cost;
+	std::string original = file;
+	bool admitted = budget_admit(data, cfg, file, can_replace,
+				     cost, deferred);
+	// A lookahead source is only any use for its own file
+	if (prepared && (!admitted || file != original)) {
+		pool_release(data, prepared->source);
+		prepared = nullptr;
+	}
+	if (!admitted)
+		return;
+
+	prepared_item p;
+	if (!prepare_item(data, cfg, file, prepared, p)) {
+		budget_refund(data, cost);
+		return;
+	}
+	p.cost = cost;
+	items.push_back(std::move(p));
+}
+
+// A batch between preparation and the scene edits. In
+// frame-aligned mode the edits wait for the video tick.
+struct spawn_batch {
+	source_config cfg; // the settings the whole batch uses
+	obs_scene_t *target; // nullptr: the overlay or compositor
+	uint64_t trigger_ns;
+	std::vector<prepared_item> items;
+	int reserved = 0; // max_active slots not yet in live
+};
+
+// Reserves up to 'want' slots under the max_active cap. Live
+// items and the slots held by batches still in flight both
+// count, so concurrent batches can never overshoot the cap. A
+// held slot moves into 'live' as its item is committed (see
+// reserve_item), so no item counts twice.
+static int reserve_slots(random_media_data *data,
+			 const source_config &cfg, int want)
+{
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	int used = (int)data->live.size() + data->reserved;
+	int got = std::clamp(cfg.max_active - used, 0, want);
+	data->reserved += got;
+	return got;
+}
+
+static void release_slots(random_media_data *data, spawn_batch &batch)
+{
+	if (!batch.reserved)
+		return;
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	data->reserved -= batch.reserved;
+	batch.reserved = 0;
+}
+
+// Everything short of touching the scene. 'count' of 0 means
+// the spawn_count setting; 'files' are spawned first and random
+// picks fill the rest. Files held back by the resource budget
+// go to 'deferred'. What does not fit under max_active waits
+// too if 'capped' is given — explicit files in 'deferred', the
+// number of random picks in 'capped' — and is dropped
+// otherwise. False if there is nothing to spawn or no slot.
+static bool prepare_batch(random_media_data *data, int count,
+			  const std::vector<std::string> &files,
+			  std::vector<std::string> *deferred,
+			  int *capped, spawn_batch &batch)
+{
+	const source_config &cfg = batch.cfg;
+	if (files.empty() && !file_count(data)) {
+		blog(LOG_WARNING,
+		     "[RandomMedia] No files in %s — skipping",
+		     describe(library_of(data)).c_str());
+		return false;
+	}
+
+	size_t total = (size_t)std::max(
+		1, count > 0 ? count : cfg.spawn_count);
+	total = std::max(total, files.size());
+
+	// The cap check and the reservation are one step
+	batch.reserved = reserve_slots(data, cfg, (int)total);
+	size_t room = (size_t)batch.reserved;
+	size_t explicit_n = std::min(files.size(), room);
+	if (room < total) {
+		size_t over = total - room;
+		if (capped && deferred) {
+			deferred->insert(deferred->end(),
+					 files.begin() + (ptrdiff_t)explicit_n,
+					 files.end());
+			*capped = (int)(over - (files.size() - explicit_n));
+		} else {
+			data->dropped += over;
+		}
+		data->cap_held += over;
+		trace_record(trace_event::skip, 0);
+		if (cfg.verbose_log)
+			blog(LOG_INFO,
+			     "[RandomMedia] Cap %d reached — %zu of %zu"
+			     " held back",
+			     cfg.max_active, over, total);
+		total = room;
+	}
+	if (!total)
+		return false;
+
+	std::mt19937 &gen = thread_rng();
+
+	// Explicit files are never swapped for another
+	std::vector<prepared_item> &items = batch.items;
+	items.reserve(total);
+	for (size_t i = 0; i < explicit_n; ++i) {
+		std::string path;
+		if (resolve_file(data, files[i], path))
+			admit_item(data, cfg, path, false, nullptr, items,
+				   deferred);
+	}
+
+	// Pre-opened lookahead sources first, fresh picks for the rest
+	size_t rest = total - explicit_n;
+	std::vector<lookahead_entry> ready = lookahead_take(data, rest);
+	std::vector<std::string> picks;
+	pick_files(data, rest - ready.size(), picks);
+	for (lookahead_entry &e : ready)
+		admit_item(data, cfg, e.file, true, &e, items, deferred);
+	for (const std::string &file : picks)
+		admit_item(data, cfg, file, true, nullptr, items,
+			   deferred);
+
+	place_batch(data, cfg, items, gen);
+	return true;
+}
+
+// Scene-mode batches for one atomic update
+struct scene_commit {
+	random_media_data *data;
+	std::vector<spawn_batch *> batches;
+};
+
+static void commit_scene_batches(void *param, obs_scene_t *scene)
+{
+	auto *c = static_cast<scene_commit *>(param);
+	for (spawn_batch *b : c->batches) {
+		batch_ctx ctx = {c->data, &b->cfg, &b->items,
+				 &b->reserved, b->trigger_ns};
+		commit_batch(&ctx, scene);
+	}
+}
+
+// Puts batches on screen: every overlay-scene batch in one
+// atomic update, the rest one by one
+static void commit_batches(random_media_data *data,
+			   std::vector<spawn_batch *> &batches)
+{
+	scene_commit overlay = {data, {}};
+	for (spawn_batch *b : batches) {
+		if (b->items.empty())
+			continue;
+		if (b->target) {
+			scene_commit one = {data, {b}};
+			obs_scene_atomic_update(b->target,
+						commit_scene_batches, &one);
+		} else if (b->cfg.use_compositor) {
+			commit_composited(data, b->cfg, b->items,
+					  &b->reserved, b->trigger_ns);
+		} else {
+			overlay.batches.push_back(b);
+		}
+	}
+	if (!overlay.batches.empty())
+		obs_scene_atomic_update(data->overlay, commit_scene_batches,
+					&overlay);
+}
+
+// Gives back what did not make it on screen and appends the
+// handles of what did; returns the number spawned
+static int finish_batch(random_media_data *data, spawn_batch &batch,
+			std::vector<uint64_t> *handles)
+{
+	int spawned = 0;
+	std::vector<uint64_t> unplaced;
+	for (prepared_item &it : batch.items) {
+		if (!it.handle) {
+			blog(LOG_ERROR,
+			     "[RandomMedia] Failed to add item: %s",
+			     it.file.c_str());
+			pool_release(data, it.media);
+			budget_refund(data, it.cost);
+			if (it.place_id)
+				unplaced.push_back(it.place_id);
+			continue;
+		}
+		if (batch.cfg.verbose_log)
+			blog(LOG_INFO, "[RandomMedia] Spawned '%s' -> %s",
+			     it.name.c_str(), it.file.c_str());
+		if (handles)
+			handles->push_back(it.handle);
+		spawned++;
+	}
+	release_places(data, unplaced);
+	batch.items.clear();
+	release_slots(data, batch);
+	return spawned;
+}
+
+// Synchronous spawn. 'target' overrides the overlay scene, for
+// hosts such as the benchmark that supply their own. Handles
+// of the spawned items are appended to 'handles' if given;
+// 'deferred' and 'capped' are as for prepare_batch.
+static bool do_spawn(random_media_data *data, obs_scene_t *target,
+		     int count, const std::vector<std::string> &files,
+		     uint64_t trigger_ns, std::vector<uint64_t> *handles,
+		     std::vector<std::string> *deferred, int *capped)
+{
+	spawn_batch batch = {config_of(data), target, trigger_ns, {}};
+	if (!prepare_batch(data, count, files, deferred, capped, batch))
+		return false;
+	std::vector<spawn_batch *> one = {&batch};
+	commit_batches(data, one);
+	int spawned = finish_batch(data, batch, handles);
+	data->lookahead_refill = true;
+	return spawned > 0;
+}
+
+// A prepared batch handed from the spawn worker to the tick
+struct scheduled_spawn {
+	spawn_batch batch;
+	spawn_request req;
+	std::vector<std::string> deferred;
+	int capped = 0;
+};
+
+// ============================================================
+//  Spawn queue
+// ============================================================
+// Vendor and hotkey callbacks only enqueue a ticket, so source
+// creation and scene edits never block the calling thread.
+static std::atomic<uint64_t> s_next_ticket{0};
+
+static void set_ticket_state(random_media_data *data,
+			     uint64_t ticket, ticket_state st,
+			     std::vector<uint64_t> handles)
+{
+	auto it = data->tickets.find(ticket);
+	if (it != data->tickets.end()) {
+		it->second = {st, std::move(handles)};
+		return;
+	}
+	data->tickets.emplace(ticket,
+			      ticket_info{st, std::move(handles)});
+	data->ticket_order.push_back(ticket);
+	while (data->ticket_order.size() > TICKET_HISTORY) {
+		data->tickets.erase(data->ticket_order.front());
+		data->ticket_order.pop_front();
+	}
+}
+
+// Caller holds queue_mutex. The newest queued request that a
+// trigger can be folded into: not scheduled, not retried
+static spawn_request *merge_target(random_media_data *data)
+{
+	auto &q = data->spawn_queue;
+	for (auto it = q.rbegin(); it != q.rend(); ++it)
+		if (!it->schedule.set && !it->wait_ns)
+			return &*it;
+	return nullptr;
+}
+
+// Adds 'count' (0 = spawn_count) more items to 'into'
+static void merge_request(const source_config &cfg,
+			  spawn_request &into, int count,
+			  std::vector<std::string> &files)
+{
+	int have = std::max(into.count > 0 ? into.count
+					    : cfg.spawn_count,
+			    (int)into.files.size());
+	int more = std::max(count > 0 ? count : cfg.spawn_count,
+			    (int)files.size());
+	into.count = have + more;
+	into.files.insert(into.files.end(),
+			  std::make_move_iterator(files.begin()),
+			  std::make_move_iterator(files.end()));
+}
+
+// Returns the ticket ID, or 0 with 'error' set (if given) when
+// the queue is full or the trigger is over the rate limit. A
+// merged trigger returns the ticket it was folded into.
+static uint64_t enqueue_spawn(random_media_data *data, int count,
+			      std::vector<std::string> files,
+			      spawn_schedule schedule, const char **error)
+{
+	source_config cfg = config_of(data);
+	uint64_t ticket = 0;
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		// The token is only taken once the trigger is queued,
+		// so a rejected one costs none
+		uint64_t now = os_gettime_ns();
+		bool token = data->bucket.wait_ns(now) == 0;
+		spawn_request *into = nullptr;
+		if (!token && cfg.storm == storm_policy::merge &&
+		    !schedule.set)
+			into = merge_target(data);
+		if (into) {
+			merge_request(cfg, *into, count, files);
+			data->rate_merged++;
+			trace_record(trace_event::trigger, into->ticket);
+			return into->ticket;
+		}
+		if (!token && cfg.storm != storm_policy::queue) {
+			if (cfg.verbose_log)
+				blog(LOG_INFO,
+				     "[RandomMedia] Rate limit — drop");
+			trace_record(trace_event::skip, 0);
+			data->rate_dropped++;
+			data->dropped++;
+			if (error)
+				*error = "rate limited";
+			return 0;
+		}
+		if (data->spawn_queue.size() >= SPAWN_QUEUE_MAX) {
+			if (cfg.verbose_log)
+				blog(LOG_INFO,
+				     "[RandomMedia] Spawn queue full"
+				     " — drop");
+			trace_record(trace_event::skip, 0);
+			data->dropped++;
+			if (error)
+				*error = "spawn queue full";
+			return 0;
+		}
+		if (token)
+			data->bucket.take(now);
+		else
+			data->rate_queued++;
+		ticket = ++s_next_ticket;
+		trace_record(trace_event::trigger, ticket);
+		data->spawn_queue.push_back({ticket, os_gettime_ns(),
+					     count, std::move(files), {}, 0,
+					     schedule, !token});
+		set_ticket_state(data, ticket, ticket_state::queued,
+				 {});
+	}
+	data->queue_cv.notify_one();
+	return ticket;
+}
+
+// Caller holds queue_mutex. Sets the state of 'req' and of
+// every ticket merged into it.
+static void settle_tickets(random_media_data *data,
+			   spawn_request &req, ticket_state state)
+{
+	for (uint64_t t : req.merged)
+		set_ticket_state(data, t, state, req.handles);
+	set_ticket_state(data, req.ticket, state,
+			 state == ticket_state::queued
+				 ? req.handles
+				 : std::move(req.handles));
+}
+
+// Caller holds queue_mutex. Requests waiting on the budget go
+// back to the front of the queue once items retire; those
+// waiting too long fail with what they spawned so far.
+static void budget_requeue(random_media_data *data)
+{
+	uint64_t now = os_gettime_ns();
+	auto &wait = data->budget_wait;
+	for (auto it = wait.begin(); it != wait.end();) {
+		if (now - it->wait_ns < BUDGET_WAIT_MAX_NS) {
+			++it;
+			continue;
+		}
+		bool any = !it->handles.empty();
+		data->budget_dropped += (size_t)it->count;
+		data->dropped += (size_t)it->count;
+		trace_record(trace_event::skip, it->ticket);
+		settle_tickets(data, *it,
+			       any ? ticket_state::spawned
+				   : ticket_state::failed);
+		it = wait.erase(it);
+	}
+	if (!data->budget_freed)
+		return;
+	data->budget_freed = false;
+	while (!wait.empty()) {
+		data->spawn_queue.push_front(std::move(wait.back()));
+		wait.pop_back();
+	}
+}
+
+// Caller holds queue_mutex. Records the outcome of one pass
+// over 'req'; files held back by the budget, and the 'capped'
+// random picks held back by max_active, are retried.
+static void settle_request(random_media_data *data,
+			   spawn_request &req,
+			   std::vector<std::string> &deferred, int capped)
+{
+	if (!deferred.empty() || capped > 0) {
+		// Only what was held back is retried
+		if (!req.wait_ns)
+			req.wait_ns = os_gettime_ns();
+		req.count = (int)deferred.size() + std::max(capped, 0);
+		req.files = std::move(deferred);
+		settle_tickets(data, req, ticket_state::queued);
+		data->budget_wait.push_back(std::move(req));
+		return;
+	}
+	bool ok = !req.handles.empty();
+	settle_tickets(data, req,
+		       ok ? ticket_state::spawned : ticket_state::failed);
+}
+
+// Caller holds queue_mutex. Folds the plain requests queued
+// behind 'req' into it; they take no further token.
+static void coalesce_queued(random_media_data *data,
+			    const source_config &cfg,
+			    spawn_request &req)
+{
+	auto &q = data->spawn_queue;
+	for (auto it = q.begin(); it != q.end();) {
+		if (it->schedule.set || it->wait_ns || it->needs_token) {
+			++it;
+			continue;
+		}
+		merge_request(cfg, req, it->count, it->files);
+		req.merged.push_back(it->ticket);
+		req.merged.insert(req.merged.end(), it->merged.begin(),
+				  it->merged.end());
+		data->coalesced++;
+		it = q.erase(it);
+	}
+}
+
+static void spawn_worker_loop(random_media_data *data)
+{
+	os_set_thread_name("random-media: spawn");
+
+	std::unique_lock<std::mutex> lk(data->queue_mutex);
+	for (;;) {
+		// A request queued over the rate limit runs once the
+		// bucket has a token for it
+		auto runnable = [data] {
+			if (data->spawn_queue.empty())
+				return false;
+			spawn_request &front = data->spawn_queue.front();
+			if (!front.needs_token)
+				return true;
+			if (!data->bucket.take(os_gettime_ns()))
+				return false;
+			front.needs_token = false;
+			return true;
+		};
+		auto ready = [&] {
+			return data->worker_stop || runnable() ||
+			       data->lookahead_refill ||
+			       data->budget_freed;
+		};
+		// Waiting requests are checked for expiry each second
+		uint64_t wait = 0;
+		if (!data->spawn_queue.empty())
+			wait = data->bucket.wait_ns(os_gettime_ns());
+		if (!data->budget_wait.empty())
+			wait = wait ? std::min<uint64_t>(wait, 1000000000ULL)
+				    : 1000000000ULL;
+		if (!wait)
+			data->queue_cv.wait(lk, ready);
+		else
+			data->queue_cv.wait_for(
+				lk, std::chrono::nanoseconds(wait), ready);
+		if (data->worker_stop)
+			break;
+		budget_requeue(data);
+		bool run = !data->spawn_queue.empty() &&
+			   !data->spawn_queue.front().needs_token;
+		if (!run && !data->lookahead_refill)
+			continue;
+
+		// Refill only while no spawn is waiting
+		if (!run) {
+			data->lookahead_refill = false;
+			lk.unlock();
+			lookahead_fill(data);
+			lk.lock();
+			continue;
+		}
+
+		source_config cfg = config_of(data);
+		spawn_request req =
+			std::move(data->spawn_queue.front());
+		data->spawn_queue.pop_front();
+
+		// Gather what else arrives within the window into
+		// one batch
+		if (cfg.coalesce_ms > 0 && !req.schedule.set &&
+		    !req.wait_ns) {
+			uint64_t until = req.queued_ns +
+					 (uint64_t)cfg.coalesce_ms * 1000000ULL;
+			uint64_t now = os_gettime_ns();
+			while (!data->worker_stop && now < until) {
+				data->queue_cv.wait_for(
+					lk, std::chrono::nanoseconds(until -
+								     now));
+				now = os_gettime_ns();
+			}
+			if (data->worker_stop)
+				break;
+			coalesce_queued(data, cfg, req);
+		}
+		lk.unlock();
+
+		bool retry = req.wait_ns != 0;
+		trace_record(trace_event::queue, req.ticket);
+		if (!retry)
+			data->queue_wait.record(os_gettime_ns() -
+						req.queued_ns);
+
+		std::vector<std::string> deferred;
+		int capped = 0;
+		int *cap_wait = cfg.storm == storm_policy::queue
+					? &capped
+					: nullptr;
+		if (cfg.frame_aligned || req.schedule.set) {
+			// The tick commits it and settles the ticket
+			auto *s = new scheduled_spawn{
+				{std::move(cfg), nullptr, req.queued_ns, {}},
+				{},
+				{}};
+			if (prepare_batch(data, req.count, req.files,
+					  &s->deferred, cap_wait,
+					  s->batch)) {
+				s->capped = capped;
+				s->req = std::move(req);
+				{
+					std::lock_guard<std::mutex> sl(
+						data->sched_mutex);
+					data->scheduled.push_back(s);
+				}
+				lk.lock();
+				continue;
+			}
+			deferred = std::move(s->deferred);
+			delete s;
+		} else {
+			do_spawn(data, nullptr, req.count, req.files,
+				 req.queued_ns, &req.handles, &deferred,
+				 cap_wait);
+		}
+
+		lk.lock();
+		settle_request(data, req, deferred, capped);
+	}
+}
+
+static void start_spawn_worker(random_media_data *data)
+{
+	data->spawn_worker = std::thread(spawn_worker_loop, data);
+}
+
+static void stop_spawn_worker(random_media_data *data)
+{
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		data->worker_stop = true;
+	}
+	data->queue_cv.notify_all();
+	if (data->spawn_worker.joinable())
+		data->spawn_worker.join();
+}
+
+static void request_lookahead_refill(random_media_data *data)
+{
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		data->lookahead_refill = true;
+	}
+	data->queue_cv.notify_one();
+}
+
+// ============================================================
+//  Frame-aligned schedule
+// ============================================================
+// The spawn worker still does everything slow — picking,
+// opening, placement — and only hands the finished batch over.
+// schedule_tick then applies everything due this frame:
+// despawns first, then every overlay batch in one atomic scene
+// update, so a burst of requests lands on a single frame.
+static bool schedule_due(const spawn_schedule &s, uint64_t frame,
+			 uint64_t horizon_ns)
+{
+	return frame >= s.due_frame && s.due_ns <= horizon_ns;
+}
+
+// Gives back what a batch that never reached the scene holds
+static void discard_batch(random_media_data *data, spawn_batch &batch)
+{
+	std::vector<uint64_t> unplaced;
+	for (prepared_item &it : batch.items) {
+		pool_release(data, it.media);
+		budget_refund(data, it.cost);
+		if (it.place_id)
+			unplaced.push_back(it.place_id);
+	}
+	release_places(data, unplaced);
+	batch.items.clear();
+	release_slots(data, batch);
+}
+
+static void apply_despawns(random_media_data *data,
+			   const std::vector<scheduled_despawn> &due)
+{
+	std::vector<item_ctx *> items;
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		for (const scheduled_despawn &d : due) {
+			if (d.all) {
+				data->live.take_if(
+					[](item_ctx *ctx) {
+						return ctx != nullptr;
+					},
+					items);
+			} else if (item_ctx *ctx = take_live(data, d.handle)) {
+				items.push_back(ctx);
+			}
+		}
+	}
+	if (!items.empty())
+		retire_items(data, items);
+}
+
+// Runs every frame on the video thread
+static void schedule_tick(void *param, float seconds)
+{
+	auto *data = static_cast<random_media_data *>(param);
+	uint64_t frame = ++data->frame_count;
+	uint64_t now = os_gettime_ns();
+	uint64_t horizon = now + (uint64_t)(seconds * 0.5e9f);
+
+	std::vector<scheduled_spawn *> due;
+	std::vector<scheduled_despawn> gone;
+	{
+		std::lock_guard<std::mutex> lk(data->sched_mutex);
+		auto &sp = data->scheduled;
+		for (size_t i = 0; i < sp.size();) {
+			if (!schedule_due(sp[i]->req.schedule, frame,
+					  horizon)) {
+				++i;
+				continue;
+			}
+			due.push_back(sp[i]);
+			sp.erase(sp.begin() + (ptrdiff_t)i);
+		}
+		auto &ds = data->despawns;
+		for (size_t i = 0; i < ds.size();) {
+			if (!schedule_due(ds[i].schedule, frame, horizon)) {
+				++i;
+				continue;
+			}
+			gone.push_back(ds[i]);
+			ds.erase(ds.begin() + (ptrdiff_t)i);
+		}
+	}
+	if (!gone.empty())
+		apply_despawns(data, gone);
+	if (due.empty())
+		return;
+
+	std::vector<spawn_batch *> batches;
+	for (scheduled_spawn *s : due) {
+		batches.push_back(&s->batch);
+		// A deadline that needed a later frame than asked
+		const spawn_schedule &sc = s->req.schedule;
+		if (sc.set && sc.due_ns &&
+		    now > sc.due_ns + (uint64_t)(seconds * 1e9f))
+			data->sched_late++;
+	}
+	commit_batches(data, batches);
+
+	// Failed items refund the budget, which takes queue_mutex
+	for (scheduled_spawn *s : due)
+		finish_batch(data, s->batch, &s->req.handles);
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		for (scheduled_spawn *s : due) {
+			settle_request(data, s->req, s->deferred,
+				       s->capped);
+			delete s;
+		}
+		data->sched_batches += due.size();
+		data->lookahead_refill = true;
+	}
+	data->queue_cv.notify_one();
+}
+
+// After the worker and the tick have stopped
+static void discard_scheduled(random_media_data *data)
+{
+	std::lock_guard<std::mutex> lk(data->sched_mutex);
+	for (scheduled_spawn *s : data->scheduled) {
+		discard_batch(data, s->batch);
+		delete s;
+	}
+	data->scheduled.clear();
+	data->despawns.clear();
+}
+
+static size_t scheduled_count(random_media_data *data)
+{
+	std::lock_guard<std::mutex> lk(data->sched_mutex);
+	return data->scheduled.size() + data->despawns.size();
+}
+
+// Queues a despawn for the tick
+static void schedule_despawn(random_media_data *data, uint64_t handle,
+			     bool all, const spawn_schedule &schedule)
+{
+	std::lock_guard<std::mutex> lk(data->sched_mutex);
+	data->despawns.push_back({handle, all, schedule});
+}
+
+static size_t queue_length(random_media_data *data)
+{
+	std::lock_guard<std::mutex> lk(data->queue_mutex);
+	return data->spawn_queue.size();
+}
+
+// Adds [{"handle": n}, ...] under "handles"
+static void fill_handles(obs_data_t *res,
+			 const std::vector<uint64_t> &handles)
+{
+	obs_data_array_t *arr = obs_data_array_create();
+	for (uint64_t h : handles) {
+		obs_data_t *o = obs_data_create();
+		obs_data_set_int(o, "handle", (long long)h);
+		obs_data_array_push_back(arr, o);
+		obs_data_release(o);
+	}
+	obs_data_set_array(res, "handles", arr);
+	obs_data_array_release(arr);
+}
+
+// Adds {decoder_mb, vram_mb, mpps} under 'name'
+static void fill_cost(obs_data_t *res, const char *name,
+		      uint64_t decoder, uint64_t vram, uint64_t pps)
+{
+	const double MB = 1024.0 * 1024.0;
+	obs_data_t *o = obs_data_create();
+	obs_data_set_double(o, "decoder_mb", (double)decoder / MB);
+	obs_data_set_double(o, "vram_mb", (double)vram / MB);
+	obs_data_set_double(o, "mpps", (double)pps / 1e6);
+	obs_data_set_obj(res, name, o);
+	obs_data_release(o);
+}
+
+// Adds "budget": {used, limit, waiting, deferred, replaced,
+// dropped}; a limit of 0 is unlimited
+static void fill_budget(obs_data_t *res, random_media_data *data)
+{
+	resource_cost used;
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		used = data->usage;
+	}
+	size_t waiting;
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		waiting = 0;
+		for (const spawn_request &r : data->budget_wait)
+			waiting += (size_t)r.count;
+	}
+
+	obs_data_t *b = obs_data_create();
+	fill_cost(b, "used", used.decoder_bytes, used.vram_bytes,
+		  used.pixels_per_sec);
+	source_config cfg = config_of(data);
+	fill_cost(b, "limit", cfg.budget_decoder, cfg.budget_vram,
+		  cfg.budget_pps);
+	obs_data_set_int(b, "waiting", (long long)waiting);
+	obs_data_set_int(b, "deferred",
+			 (long long)data->budget_deferred.load());
+	obs_data_set_int(b, "replaced",
+			 (long long)data->budget_replaced.load());
+	obs_data_set_int(b, "dropped",
+			 (long long)data->budget_dropped.load());
+	obs_data_set_obj(res, "budget", b);
+	obs_data_release(b);
+}
+
+static void fill_decode(obs_data_t *res, random_media_data *data)
+{
+	size_t sessions;
+	int limit;
+	hw_sessions(sessions, limit);
+
+	obs_data_t *d = obs_data_create();
+	obs_data_set_int(d, "hardware", data->live_hw.load());
+	obs_data_set_int(d, "software", data->live_sw.load());
+	obs_data_set_int(d, "opened_hardware",
+			 (long long)data->opened_hw.load());
+	obs_data_set_int(d, "opened_software",
+			 (long long)data->opened_sw.load());
+	obs_data_set_int(d, "fallbacks",
+			 (long long)data->hw_fallbacks.load());
+	obs_data_set_int(d, "sessions", (long long)sessions);
+	obs_data_set_int(d, "session_limit", limit);
+	obs_data_set_obj(res, "decode", d);
+	obs_data_release(d);
+}
+
+static void fill_admission(obs_data_t *res, random_media_data *data)
+{
+	source_config cfg = config_of(data);
+	double tokens;
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		tokens = data->bucket.available(os_gettime_ns());
+	}
+	int reserved;
+	{
+		std::lock_guard<std::mutex> lk(data->active_mutex);
+		reserved = data->reserved;
+	}
+
+	obs_data_t *a = obs_data_create();
+	obs_data_set_double(a, "rate", cfg.rate_limit);
+	obs_data_set_double(a, "tokens", tokens);
+	obs_data_set_int(a, "reserved", reserved);
+	obs_data_set_int(a, "cap_held", (long long)data->cap_held.load());
+	obs_data_set_int(a, "rate_dropped",
+			 (long long)data->rate_dropped.load());
+	obs_data_set_int(a, "rate_queued",
+			 (long long)data->rate_queued.load());
+	obs_data_set_int(a, "merged",
+			 (long long)data->rate_merged.load());
+	obs_data_set_int(a, "coalesced",
+			 (long long)data->coalesced.load());
+	obs_data_set_obj(res, "admission", a);
+	obs_data_release(a);
+}
 
-static void on_media_ended(void *param, calldata_t * /*cd*/)
+// Adds {count, p50_ms, p95_ms, p99_ms} under 'name'
+static void fill_histogram(obs_data_t *res, const char *name,
+			   const latency_histogram &h)
 {
-	hide_ctx *ctx = static_cast<hide_ctx *>(param);
-	{
-		std::lock_guard<std::mutex> lk(ctx->data->active_mutex);
-		auto &v = ctx->data->active_items;
-		v.erase(std::remove(v.begin(), v.end(), ctx->item),
-			v.end());
-	}
-	obs_sceneitem_remove(ctx->item);
-	obs_source_release(ctx->media_source);
-	delete ctx;
-	blog(LOG_INFO, "[RandomMedia] Media ended — item removed");
+	obs_data_t *o = obs_data_create();
+	obs_data_set_int(o, "count", (long long)h.count());
+	obs_data_set_double(o, "p50_ms", h.percentile_ms(0.50));
+	obs_data_set_double(o, "p95_ms", h.percentile_ms(0.95));
+	obs_data_set_double(o, "p99_ms", h.percentile_ms(0.99));
+	obs_data_set_obj(res, name, o);
+	obs_data_release(o);
 }
 
 // ============================================================
-//  Spawn one item
-// ============================================================
-// ============================================================
-//  Audio filters: compressor + limiter
+//  Vendor callbacks
 // ============================================================
-static void apply_audio_filters(obs_source_t *src,
-				random_media_data *data)
+// Every request takes an optional "instance": the UUID or name
+// of a Random Media Source. It may be left out while there is
+// only one.
+static random_media_data *find_instance(const instance_map_t::reader &map,
+					obs_data_t *req, obs_data_t *res)
 {
-	// ---- Compressor ----
-	if (data->use_compressor) {
-		obs_data_t *cs = obs_data_create();
-		obs_data_set_double(cs, "threshold",
-				    data->comp_threshold);
-		obs_data_set_double(cs, "ratio", data->comp_ratio);
-		obs_data_set_double(cs, "attack_time",
-				    data->comp_attack);
-		obs_data_set_double(cs, "release_time",
-				    data->comp_release);
-		obs_data_set_double(cs, "output_gain",
-				    data->comp_output_gain);
-		obs_source_t *f = obs_source_create(
-			"compressor_filter", "RMS_Compressor", cs,
-			nullptr);
-		obs_data_release(cs);
-		if (f) {
-			obs_source_filter_add(src, f);
-			obs_source_release(f);
-		}
-	}
-
-	// ---- Limiter ----
-	if (data->use_limiter) {
-		obs_data_t *ls = obs_data_create();
-		obs_data_set_double(ls, "threshold",
-				    data->limiter_threshold);
-		obs_data_set_double(ls, "release_time", 60.0);
-		obs_source_t *f = obs_source_create(
-			"limiter_filter", "RMS_Limiter", ls,
-			nullptr);
-		obs_data_release(ls);
-		if (f) {
-			obs_source_filter_add(src, f);
-			obs_source_release(f);
-		}
+	const char *id = obs_data_get_string(req, "instance");
+	const char *error = "no such instance";
+	if (!id || !*id) {
+		if (map->size() == 1)
+			return map->begin()->second;
+		error = map->empty() ? "plugin not initialized"
+				     : "several instances — pass 'instance'";
+	} else {
+		auto it = map->find(id);
+		if (it != map->end())
+			return it->second;
+		for (const auto &kv : *map)
+			if (strcmp(obs_source_get_name(kv.second->source),
+				   id) == 0)
+				return kv.second;
 	}
+	obs_data_set_string(res, "status", "error");
+	obs_data_set_string(res, "message", error);
+	return nullptr;
 }
 
-static std::atomic<int> s_uid{0};
-
-static void spawn_one(random_media_data *data, obs_scene_t *scene,
-		      const std::string &file, std::mt19937 &gen)
+// Optional timing of spawn and despawn requests: "at_ms" (Unix
+// time in ms), "delay_ms" or "frame_offset" (video frames from
+// now). Bounded by SCHEDULE_MAX_NS; false and an error set in
+// 'res' if it is further out.
+static bool parse_schedule(random_media_data *data, obs_data_t *req,
+			   obs_data_t *res, spawn_schedule &out)
 {
-	std::string name = "RMS_" + std::to_string(++s_uid);
-
-	obs_data_t *s = obs_data_create();
-	obs_data_set_string(s, "local_file", file.c_str());
-	obs_data_set_bool(s, "is_local_file", true);
-	obs_data_set_bool(s, "restart_on_activate", true);
-	obs_data_set_bool(s, "close_when_inactive", false);
-	obs_data_set_bool(s, "clear_on_media_end", true);
-
-	obs_source_t *media = obs_source_create("ffmpeg_source",
-						name.c_str(), s,
-						nullptr);
-	obs_data_release(s);
+	bool at = obs_data_has_user_value(req, "at_ms");
+	bool delay = obs_data_has_user_value(req, "delay_ms");
+	bool frames = obs_data_has_user_value(req, "frame_offset");
+	out = spawn_schedule{};
+	if (!at && !delay && !frames)
+		return true;
 
-	if (!media) {
-		blog(LOG_ERROR,
-		     "[RandomMedia] Failed to create source: %s",
-		     file.c_str());
-		return;
+	out.set = true;
+	uint64_t now = os_gettime_ns();
+	int64_t ahead = 0; // ns from now
+	if (at) {
+		int64_t unix_ns =
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now()
+					.time_since_epoch())
+				.count();
+		ahead = obs_data_get_int(req, "at_ms") * 1000000 -
+			unix_ns;
+	} else if (delay) {
+		ahead = obs_data_get_int(req, "delay_ms") * 1000000;
 	}
+	if (ahead > 0)
+		out.due_ns = now + (uint64_t)ahead;
 
-	// Set volume: convert dB to linear (0 dB = 1.0)
-	float vol_linear = obs_db_to_mul(data->volume_db);
-	obs_source_set_volume(media, vol_linear);
-
-	// Monitor + Output so streamer can hear it
-	obs_source_set_monitoring_type(
-		media, OBS_MONITORING_TYPE_MONITOR_AND_OUTPUT);
+	int64_t offset = frames ? obs_data_get_int(req, "frame_offset")
+				: 0;
+	if (offset > 0) {
+		out.due_frame = data->frame_count + (uint64_t)offset;
+		struct obs_video_info ovi = {};
+		if (obs_get_video_info(&ovi) && ovi.fps_num)
+			ahead = std::max<int64_t>(
+				ahead, offset * 1000000000LL * ovi.fps_den /
+					       ovi.fps_num);
+	}
 
-	// Compressor + Limiter filters
-	apply_audio_filters(media, data);
+	if (ahead > (int64_t)SCHEDULE_MAX_NS) {
+		obs_data_set_string(res, "status", "error");
+		obs_data_set_string(res, "message",
+				    "scheduled too far ahead");
+		return false;
+	}
+	return true;
+}
 
-	obs_sceneitem_t *item = obs_scene_add(scene, media);
-	if (!item) {
-		blog(LOG_ERROR,
-		     "[RandomMedia] obs_scene_add failed: %s",
-		     file.c_str());
-		obs_source_release(media);
+static void fill_ticket_response(obs_data_t *res,
+				 random_media_data *data,
+				 uint64_t ticket, const char *error)
+{
+	if (!ticket) {
+		obs_data_set_string(res, "status", "error");
+		obs_data_set_string(res, "message",
+				    error ? error : "spawn queue full");
 		return;
 	}
-	obs_sceneitem_set_visible(item, true);
-
-	// ---- Random transform ----
-	if (data->do_random_transform) {
-		struct obs_video_info ovi = {};
-		obs_get_video_info(&ovi);
-		float cw = (float)ovi.base_width;
-		float ch = (float)ovi.base_height;
-
-		float smin = data->min_scale / 100.0f;
-		float smax = data->max_scale / 100.0f;
-		if (smin > smax)
-			std::swap(smin, smax);
-
-		std::uniform_real_distribution<float> ds(smin, smax);
-		float sx = ds(gen) * cw;
-
-		// Source natural size
-		float src_w =
-			(float)obs_source_get_width(media);
-		float src_h =
-			(float)obs_source_get_height(media);
-		if (src_w < 1.0f)
-			src_w = cw * 0.3f;
-		if (src_h < 1.0f)
-			src_h = ch * 0.3f;
-
-		float scale_x = sx / src_w;
-		float scale_y = data->preserve_aspect
-					? scale_x
-					: (ds(gen) * ch / src_h);
-
-		float item_w = src_w * scale_x;
-		float item_h = src_h * scale_y;
-
-		// Keep fully inside canvas
-		float max_x = std::max(0.0f, cw - item_w);
-		float max_y = std::max(0.0f, ch - item_h);
+	obs_data_set_string(res, "status", "ok");
+	obs_data_set_int(res, "ticket", (long long)ticket);
+	obs_data_set_int(res, "queue_length",
+			 (long long)queue_length(data));
+	std::lock_guard<std::mutex> lk(data->active_mutex);
+	obs_data_set_int(res, "active_count",
+			 (long long)data->live.size());
+}
 
-		std::uniform_real_distribution<float> dx(0.0f,
-							 max_x);
-		std::uniform_real_distribution<float> dy(0.0f,
-							 max_y);
+static void vendor_spawn_cb(obs_data_t *req, obs_data_t *res,
+			    void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	spawn_schedule when;
+	if (!parse_schedule(data, req, res, when))
+		return;
+	const char *error = nullptr;
+	uint64_t ticket = enqueue_spawn(data, 0, {}, when, &error);
+	fill_ticket_response(res, data, ticket, error);
+}
 
-		vec2 pos = {dx(gen), dy(gen)};
-		obs_sceneitem_set_pos(item, &pos);
+// { "count": n, "files": [{"file": "a.mp4"}, ...] } — both
+// optional; files may be absolute or relative to the folder.
+// Like spawn it takes an optional schedule.
+static void vendor_spawn_batch_cb(obs_data_t *req, obs_data_t *res,
+				  void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	spawn_schedule when;
+	if (!parse_schedule(data, req, res, when))
+		return;
+	int count = (int)obs_data_get_int(req, "count");
+	std::vector<std::string> files;
+	obs_data_array_t *arr = obs_data_get_array(req, "files");
+	size_t n = obs_data_array_count(arr);
+	for (size_t i = 0; i < n; ++i) {
+		obs_data_t *item = obs_data_array_item(arr, i);
+		const char *file = obs_data_get_string(item, "file");
+		if (file && *file)
+			files.emplace_back(file);
+		obs_data_release(item);
+	}
+	obs_data_array_release(arr);
 
-		vec2 scale = {scale_x, scale_y};
-		obs_sceneitem_set_scale(item, &scale);
+	const char *error = nullptr;
+	uint64_t ticket = enqueue_spawn(data, count, std::move(files),
+					when, &error);
+	fill_ticket_response(res, data, ticket, error);
+}
 
-		if (!data->disable_rot) {
-			float rmin = data->min_rot;
-			float rmax = data->max_rot;
-			if (rmin > rmax)
-				std::swap(rmin, rmax);
-			std::uniform_real_distribution<float> dr(
-				rmin, rmax);
-			obs_sceneitem_set_rot(item, dr(gen));
+static void vendor_spawn_status_cb(obs_data_t *req,
+				   obs_data_t *res,
+				   void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	uint64_t ticket =
+		(uint64_t)obs_data_get_int(req, "ticket");
+	const char *state = "unknown";
+	std::vector<uint64_t> handles;
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		auto it = data->tickets.find(ticket);
+		if (it != data->tickets.end()) {
+			handles = it->second.handles;
+			switch (it->second.state) {
+			case ticket_state::queued:
+				state = "queued";
+				break;
+			case ticket_state::spawned:
+				state = "spawned";
+				break;
+			case ticket_state::failed:
+				state = "failed";
+				break;
+			}
 		}
 	}
+	obs_data_set_string(res, "status", "ok");
+	obs_data_set_int(res, "ticket", (long long)ticket);
+	obs_data_set_string(res, "state", state);
+	fill_handles(res, handles);
+	obs_data_set_int(res, "queue_length",
+			 (long long)queue_length(data));
+}
+
+// Whether a despawn waits for the tick; "queued" is set in
+// the response if so
+static bool despawn_deferred(random_media_data *data,
+			     const spawn_schedule &when, obs_data_t *res)
+{
+	bool deferred = when.set || config_of(data).frame_aligned;
+	if (deferred)
+		obs_data_set_bool(res, "queued", true);
+	return deferred;
+}
 
+// { "handle": n } — a handle from spawn_status; takes an
+// optional schedule like spawn
+static void vendor_despawn_cb(obs_data_t *req, obs_data_t *res,
+			      void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	spawn_schedule when;
+	if (!parse_schedule(data, req, res, when))
+		return;
+	uint64_t handle = (uint64_t)obs_data_get_int(req, "handle");
+	bool ok;
 	{
 		std::lock_guard<std::mutex> lk(data->active_mutex);
-		data->active_items.push_back(item);
+		item_ctx **ctx = data->live.find(handle);
+		ok = ctx && *ctx;
 	}
-
-	if (data->hide_on_end) {
-		obs_source_get_ref(media);
-		auto *ctx = new hide_ctx{data, item, media};
-		signal_handler_connect(
-			obs_source_get_signal_handler(media),
-			"media_ended", on_media_ended, ctx);
+	if (ok && despawn_deferred(data, when, res))
+		schedule_despawn(data, handle, false, when);
+	else if (ok)
+		ok = retire_one(data, handle);
+	if (!ok) {
+		obs_data_set_string(res, "status", "error");
+		obs_data_set_string(res, "message",
+				    "no such item");
+		return;
 	}
+	obs_data_set_string(res, "status", "ok");
+}
 
-	obs_source_release(media);
-	blog(LOG_INFO, "[RandomMedia] Spawned '%s' -> %s",
-	     name.c_str(), file.c_str());
+static void vendor_despawn_all_cb(obs_data_t *req, obs_data_t *res,
+				  void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	spawn_schedule when;
+	if (!parse_schedule(data, req, res, when))
+		return;
+	obs_data_set_string(res, "status", "ok");
+	if (despawn_deferred(data, when, res))
+		schedule_despawn(data, 0, true, when);
+	else
+		obs_data_set_int(res, "removed",
+				 (long long)retire_all(data));
 }
 
-// ============================================================
-//  Main spawn
-// ============================================================
-static void do_spawn(random_media_data *data)
+static void vendor_stats_cb(obs_data_t *req, obs_data_t *res,
+			    void * /*priv*/)
 {
-	if (data->file_list.empty()) {
-		blog(LOG_WARNING,
-		     "[RandomMedia] No files in '%s' — skipping",
-		     data->folder.c_str());
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
 		return;
-	}
+
+	obs_data_t *stages = obs_data_create();
+	for (int i = 0; i < STAGE_COUNT; ++i)
+		fill_histogram(stages, s_stage_names[i],
+			       data->stages[i]);
+	obs_data_set_obj(res, "stages", stages);
+	obs_data_release(stages);
+
+	fill_histogram(res, "queue_wait", data->queue_wait);
+	fill_histogram(res, "first_frame_lookahead",
+		       data->start_hit);
+	fill_histogram(res, "first_frame_cold", data->start_miss);
+
+	size_t active, pooled;
 	{
 		std::lock_guard<std::mutex> lk(data->active_mutex);
-		int active =
-			(int)data->active_items.size();
-		if (active >= data->max_active) {
-			blog(LOG_INFO,
-			     "[RandomMedia] Cap %d/%d — skip",
-			     active, data->max_active);
-			return;
-		}
+		active = data->live.size();
 	}
-
-	obs_source_t *scene_src =
-		obs_frontend_get_current_scene();
-	if (!scene_src) {
-		blog(LOG_WARNING,
-		     "[RandomMedia] No current scene");
-		return;
+	{
+		std::lock_guard<std::mutex> lk(data->pool_mutex);
+		pooled = data->pool_idle.size();
 	}
-	obs_scene_t *scene =
-		obs_scene_from_source(scene_src);
+	obs_data_set_string(res, "status", "ok");
+	obs_data_set_int(res, "active", (long long)active);
+	obs_data_set_int(res, "pooled", (long long)pooled);
+	obs_data_set_bool(res, "warming", data->warming.load());
+	obs_data_set_int(res, "dropped",
+			 (long long)data->dropped.load());
+	obs_data_set_int(res, "queue_length",
+			 (long long)queue_length(data));
+	obs_data_set_int(res, "pool_hits",
+			 (long long)data->pool_hits.load());
+	obs_data_set_int(res, "pool_misses",
+			 (long long)data->pool_misses.load());
 
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_int_distribution<size_t> pick(
-		0, data->file_list.size() - 1);
+	obs_data_set_int(res, "normalized",
+			 (long long)data->normalized.load());
+	obs_data_set_int(res, "normalize_fallbacks",
+			 (long long)data->normalize_fallbacks.load());
+	obs_data_set_int(res, "place_overlaps",
+			 (long long)data->place_overlaps.load());
+	obs_data_set_int(res, "scheduled",
+			 (long long)scheduled_count(data));
+	obs_data_set_int(res, "scheduled_batches",
+			 (long long)data->sched_batches.load());
+	obs_data_set_int(res, "scheduled_late",
+			 (long long)data->sched_late.load());
 
-	int count = std::max(1, data->spawn_count);
-	for (int i = 0; i < count; ++i)
-		spawn_one(data, scene,
-			  data->file_list[pick(gen)], gen);
+	fill_budget(res, data);
+	fill_admission(res, data);
+	fill_decode(res, data);
 
-	obs_source_release(scene_src);
+	size_t proxies_ready, proxies_pending;
+	proxy_cache_stats(proxies_ready, proxies_pending);
+	obs_data_set_int(res, "proxies_ready", (long long)proxies_ready);
+	obs_data_set_int(res, "proxies_pending",
+			 (long long)proxies_pending);
+
+	remote_cache_counters rc;
+	remote_cache_stats(rc);
+	obs_data_t *remote = obs_data_create();
+	obs_data_set_int(remote, "files", (long long)rc.files);
+	obs_data_set_double(remote, "cached_mb",
+			    (double)rc.bytes / (1024.0 * 1024.0));
+	obs_data_set_int(remote, "pending", (long long)rc.pending);
+	obs_data_set_int(remote, "hits", (long long)rc.hits);
+	obs_data_set_int(remote, "misses", (long long)rc.misses);
+	obs_data_set_double(remote, "downloaded_mb",
+			    (double)rc.downloaded / (1024.0 * 1024.0));
+	obs_data_set_int(remote, "resumed", (long long)rc.resumed);
+	obs_data_set_int(remote, "failed", (long long)rc.failed);
+	obs_data_set_int(remote, "evicted", (long long)rc.evicted);
+	obs_data_set_int(remote, "skipped",
+			 (long long)data->remote_skipped.load());
+	obs_data_set_obj(res, "remote", remote);
+	obs_data_release(remote);
 }
 
-// ============================================================
-//  Vendor callbacks
-// ============================================================
-static void vendor_spawn_cb(obs_data_t * /*req*/,
-			    obs_data_t *res, void * /*priv*/)
+static void vendor_reload_cb(obs_data_t *req, obs_data_t *res,
+			     void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	uint64_t job = start_reload(data);
+	obs_data_set_string(res, "status", "ok");
+	obs_data_set_int(res, "job", (long long)job);
+}
+
+// { path } -> { file_count }. Writes the current catalog as a
+// binary manifest, which later loads without any folder walk.
+static void vendor_save_manifest_cb(obs_data_t *req, obs_data_t *res,
+				    void * /*priv*/)
 {
-	if (!g_data) {
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	const char *path = obs_data_get_string(req, "path");
+	if (!path || !*path) {
+		obs_data_set_string(res, "status", "error");
+		obs_data_set_string(res, "message", "missing path");
+		return;
+	}
+	file_list_t::reader files(data->file_list);
+	if (!manifest_save(path, *files)) {
 		obs_data_set_string(res, "status", "error");
 		obs_data_set_string(res, "message",
-				    "plugin not initialized");
+				    "cannot write manifest");
 		return;
 	}
-	do_spawn(g_data);
 	obs_data_set_string(res, "status", "ok");
-	std::lock_guard<std::mutex> lk(g_data->active_mutex);
-	obs_data_set_int(res, "active_count",
-			 (long long)g_data->active_items.size());
+	obs_data_set_int(res, "file_count", (long long)files->size());
+}
+
+// { job } -> { state, scanned, generation, file_count }.
+// 'scanned' is the running (or last) job's progress,
+// 'generation' the job whose list is published now.
+static void vendor_reload_status_cb(obs_data_t *req, obs_data_t *res,
+				    void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	random_media_data *data = find_instance(instances, req, res);
+	if (!data)
+		return;
+	uint64_t job = (uint64_t)obs_data_get_int(req, "job");
+	if (!job)
+		job = data->reload_job;
+	obs_data_set_string(res, "status", "ok");
+	obs_data_set_int(res, "job", (long long)job);
+	obs_data_set_string(res, "state", reload_state(data, job));
+	obs_data_set_int(res, "scanned",
+			 (long long)data->reload_scanned.load());
+	obs_data_set_int(res, "generation",
+			 (long long)data->reload_done.load());
+	obs_data_set_int(res, "file_count",
+			 (long long)file_count(data));
+}
+
+// Lists every instance as { uuid, name, file_count, active }
+static void vendor_instances_cb(obs_data_t * /*req*/,
+				obs_data_t *res, void * /*priv*/)
+{
+	instance_map_t::reader instances(g_instances);
+	obs_data_array_t *arr = obs_data_array_create();
+	for (const auto &kv : *instances) {
+		random_media_data *data = kv.second;
+		obs_data_t *e = obs_data_create();
+		obs_data_set_string(e, "uuid", kv.first.c_str());
+		obs_data_set_string(e, "name",
+				    obs_source_get_name(data->source));
+		obs_data_set_int(e, "file_count",
+				 (long long)file_count(data));
+		{
+			std::lock_guard<std::mutex> lk(
+				data->active_mutex);
+			obs_data_set_int(e, "active",
+					 (long long)data->live.size());
+		}
+		obs_data_array_push_back(arr, e);
+		obs_data_release(e);
+	}
+	obs_data_set_string(res, "status", "ok");
+	obs_data_set_array(res, "instances", arr);
+	obs_data_array_release(arr);
+}
+
+// Trace files go to the module config dir unless a path is
+// given; the log is process-wide, not per instance
+static bool export_trace(const char *path, std::string &out,
+			 size_t &events)
+{
+	if (path && *path) {
+		out = path;
+	} else {
+		char *dir = obs_module_config_path("traces");
+		if (!dir)
+			return false;
+		os_mkdirs(dir);
+		// Named by wall-clock time, like OBS recordings
+		char *name = os_generate_formatted_filename(
+			"json", false, "trace-%CCYY-%MM-%DD %hh-%mm-%ss");
+		out = std::string(dir) + "/" + (name ? name : "trace.json");
+		bfree(name);
+		bfree(dir);
+	}
+	return trace_export(out, events);
 }
 
-static void vendor_reload_cb(obs_data_t * /*req*/,
-			     obs_data_t *res, void * /*priv*/)
+// { path? } -> { path, events }
+static void vendor_trace_export_cb(obs_data_t *req, obs_data_t *res,
+				   void * /*priv*/)
 {
-	if (!g_data) {
+	std::string path;
+	size_t events = 0;
+	if (!export_trace(obs_data_get_string(req, "path"), path,
+			  events)) {
 		obs_data_set_string(res, "status", "error");
+		obs_data_set_string(res, "message",
+				    "cannot write trace file");
 		return;
 	}
-	update_file_list(g_data);
 	obs_data_set_string(res, "status", "ok");
-	obs_data_set_int(res, "file_count",
-			 (long long)g_data->file_list.size());
+	obs_data_set_string(res, "path", path.c_str());
+	obs_data_set_int(res, "events", (long long)events);
 }
 
 // ============================================================
@@ -462,21 +3825,33 @@ static bool btn_test_spawn(obs_properties_t *,
 {
 	auto *data = static_cast<random_media_data *>(priv);
 	blog(LOG_INFO, "[RandomMedia] Test Spawn clicked");
-	do_spawn(data);
+	enqueue_spawn(data, 0, {}, spawn_schedule{}, nullptr);
 	return true;
 }
 
+static bool btn_export_trace(obs_properties_t *,
+			     obs_property_t *, void *)
+{
+	std::string path;
+	size_t events = 0;
+	if (export_trace(nullptr, path, events))
+		blog(LOG_INFO, "[RandomMedia] Wrote %zu trace events to %s",
+		     events, path.c_str());
+	return false;
+}
+
 static bool btn_reload_files(obs_properties_t *props,
 			     obs_property_t *, void *priv)
 {
 	auto *data = static_cast<random_media_data *>(priv);
-	update_file_list(data);
+	start_reload(data);
 	obs_property_t *info =
 		obs_properties_get(props, "file_count_info");
 	if (info) {
 		char buf[64];
-		snprintf(buf, sizeof(buf), "Files found: %zu",
-			 data->file_list.size());
+		snprintf(buf, sizeof(buf),
+			 "Files found: %zu (reloading…)",
+			 file_count(data));
 		obs_property_set_description(info, buf);
 	}
 	return true;
@@ -490,76 +3865,429 @@ static const char *source_get_name(void *)
 	return "Random Media Source";
 }
 
+// ============================================================
+//  Warm start
+// ============================================================
+// Sources restored from a snapshot are warmed up by one thread,
+// started at post_load: each gets its pool and lookahead filled
+// and then the folder check. The thread waits until no source
+// has been created for WARM_SETTLE_NS, so none of it competes
+// with the scene collection load, and warms one source at a
+// time.
+static constexpr uint64_t WARM_SETTLE_NS = 2000000000ULL;
+
+static struct {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::string> queue; // source UUIDs
+	uint64_t last_ns = 0;
+	bool started = false;
+	bool stop = false;
+	std::thread thread;
+} s_warm;
+
+static void warm_enqueue(random_media_data *data)
+{
+	{
+		std::lock_guard<std::mutex> lk(s_warm.mutex);
+		s_warm.queue.push_back(obs_source_get_uuid(data->source));
+		s_warm.last_ns = os_gettime_ns();
+	}
+	s_warm.cv.notify_one();
+}
+
+// Does what the first update left out. Nothing if the library
+// has changed since, as that update did it all.
+static void warm_source(random_media_data *data)
+{
+	std::lock_guard<std::mutex> lk(data->warm_mutex);
+	if (!data->warming)
+		return;
+	library_config lib = library_of(data);
+	blog(LOG_INFO, "[RandomMedia] Checking %s against the snapshot",
+	     describe(lib).c_str());
+	data->warming = false;
+	pool_resize(data);
+	request_lookahead_refill(data);
+	start_watcher(data);
+	start_reload(data);
+}
+
+static void warm_thread_main(void)
+{
+	os_set_thread_name("random-media: warm");
+
+	std::unique_lock<std::mutex> lk(s_warm.mutex);
+	for (;;) {
+		s_warm.cv.wait(lk, [] {
+			return s_warm.stop || !s_warm.queue.empty();
+		});
+		if (s_warm.stop)
+			break;
+		uint64_t now = os_gettime_ns();
+		if (now < s_warm.last_ns + WARM_SETTLE_NS) {
+			s_warm.cv.wait_for(
+				lk, std::chrono::nanoseconds(
+					    s_warm.last_ns + WARM_SETTLE_NS -
+					    now));
+			continue;
+		}
+		std::string uuid = std::move(s_warm.queue.front());
+		s_warm.queue.pop_front();
+		lk.unlock();
+		// A reference keeps the source from being destroyed
+		// while it warms; the map itself is only held for the
+		// lookup, as create and destroy wait on its readers.
+		// Destroyed sources are no longer in it, and one being
+		// destroyed gives no reference.
+		random_media_data *data = nullptr;
+		obs_source_t *ref = nullptr;
+		{
+			instance_map_t::reader instances(g_instances);
+			auto it = instances->find(uuid);
+			if (it != instances->end()) {
+				ref = obs_source_get_ref(it->second->source);
+				data = it->second;
+			}
+		}
+		if (ref) {
+			warm_source(data);
+			obs_source_release(ref);
+		}
+		lk.lock();
+	}
+}
+
+static void warm_start_thread(void)
+{
+	std::lock_guard<std::mutex> lk(s_warm.mutex);
+	if (s_warm.started)
+		return;
+	s_warm.started = true;
+	s_warm.stop = false;
+	s_warm.thread = std::thread(warm_thread_main);
+}
+
+static void warm_stop_thread(void)
+{
+	{
+		std::lock_guard<std::mutex> lk(s_warm.mutex);
+		s_warm.stop = true;
+		s_warm.queue.clear();
+	}
+	s_warm.cv.notify_all();
+	if (s_warm.thread.joinable())
+		s_warm.thread.join();
+	s_warm.started = false;
+}
+
 static void source_update(void *d, obs_data_t *settings);
 
+// Synchronous spawn into a caller-supplied scene, bypassing the
+// queue. Used by headless hosts such as the benchmark.
+static void proc_spawn(void *d, calldata_t *cd)
+{
+	auto *data = static_cast<random_media_data *>(d);
+	auto *scene =
+		static_cast<obs_scene_t *>(calldata_ptr(cd, "scene"));
+	calldata_set_bool(cd, "spawned",
+			  do_spawn(data, scene, 0, {},
+				   os_gettime_ns(), nullptr, nullptr,
+				   nullptr));
+}
+
+// The path vendor and hotkey triggers take: through the spawn
+// queue into the overlay. The ticket is 0 if it was dropped.
+static void proc_enqueue(void *d, calldata_t *cd)
+{
+	auto *data = static_cast<random_media_data *>(d);
+	calldata_set_int(cd, "ticket",
+			 (long long)enqueue_spawn(data, 0, {},
+						  spawn_schedule{},
+						  nullptr));
+}
+
+// Fills 'stats' as the vendor 'stats' request would
+static void proc_stats(void *d, calldata_t *cd)
+{
+	auto *data = static_cast<random_media_data *>(d);
+	auto *res = static_cast<obs_data_t *>(calldata_ptr(cd, "stats"));
+	obs_data_t *req = obs_data_create();
+	obs_data_set_string(req, "instance",
+			    obs_source_get_uuid(data->source));
+	vendor_stats_cb(req, res, nullptr);
+	obs_data_release(req);
+}
+
 static void *source_create(obs_data_t *settings,
 			   obs_source_t *source)
 {
 	auto *data = new random_media_data();
 	data->source = source;
-	g_data = data;
+	data->instance_no = ++g_instance_count;
+	data->overlay = obs_scene_create_private("RMS_Overlay");
 	source_update(data, settings);
-	blog(LOG_INFO, "[Random Media Source] loaded");
+	data->created = true;
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void spawn(in ptr scene, out bool spawned)",
+			 proc_spawn, data);
+	proc_handler_add(ph, "void enqueue(out int ticket)",
+			 proc_enqueue, data);
+	proc_handler_add(ph, "void stats(in ptr stats)", proc_stats,
+			 data);
+	start_spawn_worker(data);
+	obs_add_tick_callback(lifetime_tick, data);
+	obs_add_tick_callback(schedule_tick, data);
+
+	// Hotkeys stay per source, so TriggerHotkeyByName needs
+	// the source as its context
+	data->hotkey = obs_hotkey_register_source(
+		source, "random_media_spawn", "Random Media: Spawn",
+		hotkey_spawn_cb, data);
+	g_instances.modify([&](auto &m) {
+		m[obs_source_get_uuid(source)] = data;
+	});
+	// Once registered, so the warm thread can find it
+	if (data->warming)
+		warm_enqueue(data);
+	else
+		request_lookahead_refill(data);
+	blog(LOG_INFO, "[Random Media Source] loaded: %s",
+	     obs_source_get_name(source));
 	return data;
 }
 
 static void source_destroy(void *d)
 {
 	auto *data = static_cast<random_media_data *>(d);
-	if (g_data == data)
-		g_data = nullptr;
+	// Returns once no vendor callback can still reach 'data'
+	g_instances.modify([&](auto &m) {
+		m.erase(obs_source_get_uuid(data->source));
+	});
+	obs_hotkey_unregister(data->hotkey);
+	obs_remove_tick_callback(lifetime_tick, data);
+	obs_remove_tick_callback(schedule_tick, data);
+	stop_spawn_worker(data);
+	discard_scheduled(data);
+	stop_watcher(data);
+	cancel_reload(data);
+	// Nothing may point at 'data' once it is freed
+	retire_all(data);
+	obs_scene_release(data->overlay);
+	lookahead_flush(data);
+	audio_bus_destroy(data->bus);
+	pool_clear(data);
+	blog(LOG_INFO,
+	     "[RandomMedia] Pool hits: %llu, misses: %llu",
+	     (unsigned long long)data->pool_hits.load(),
+	     (unsigned long long)data->pool_misses.load());
 	delete data;
 }
 
 static void source_update(void *d, obs_data_t *settings)
 {
 	auto *data = static_cast<random_media_data *>(d);
-	std::string new_folder =
-		obs_data_get_string(settings, "folder");
-	bool changed = (new_folder != data->folder);
+	std::string folder = obs_data_get_string(settings, "folder");
+	library_config lib;
+	if (!folder.empty())
+		lib.roots.push_back(folder);
+	obs_data_array_t *extra =
+		obs_data_get_array(settings, "extra_folders");
+	for (size_t i = 0; i < obs_data_array_count(extra); ++i) {
+		obs_data_t *e = obs_data_array_item(extra, i);
+		std::string f = obs_data_get_string(e, "value");
+		if (!f.empty() && std::find(lib.roots.begin(),
+					    lib.roots.end(),
+					    f) == lib.roots.end())
+			lib.roots.push_back(std::move(f));
+		obs_data_release(e);
+	}
+	obs_data_array_release(extra);
+	lib.manifest = obs_data_get_string(settings, "manifest");
+	lib.recursive = obs_data_get_bool(settings, "recursive");
+	lib.weights = obs_data_get_string(settings, "weights_file");
+
+	library_config old = library_of(data);
+	bool changed = (lib.roots != old.roots ||
+			lib.manifest != old.manifest ||
+			lib.recursive != old.recursive);
+	bool reselect = lib.weights != old.weights;
+
+	// The first update may restore the list from the snapshot
+	// rather than scan; warm_source does the rest later. A new
+	// library before then is scanned as usual.
+	std::lock_guard<std::mutex> warm_lk(data->warm_mutex);
+	file_catalog snapshot;
+	bool warm = changed && !data->created &&
+		    obs_data_get_bool(settings, "warm_start") &&
+		    load_snapshot(lib, snapshot);
+	if (warm || changed)
+		data->warming = warm;
+
+	// The watcher thread reads the library on rescans
+	if (changed) {
+		stop_watcher(data);
+		data->library.publish(library_config(lib));
+	} else if (reselect) {
+		data->library.publish(library_config(lib));
+	}
 
-	data->folder = new_folder;
-	data->do_random_transform =
+	source_config cfg;
+	cfg.do_random_transform =
 		obs_data_get_bool(settings, "random_transform");
-	data->hide_on_end =
-		obs_data_get_bool(settings, "hide_on_end");
-	data->min_scale = (float)obs_data_get_double(
-		settings, "min_scale");
-	data->max_scale = (float)obs_data_get_double(
-		settings, "max_scale");
-	data->preserve_aspect =
+	cfg.hide_on_end = obs_data_get_bool(settings, "hide_on_end");
+	cfg.image_duration = (float)obs_data_get_double(
+		settings, "image_duration");
+	cfg.use_compositor = strcmp(obs_data_get_string(
+					    settings, "render_mode"),
+				    "compositor") == 0;
+	cfg.max_lifetime =
+		(int)obs_data_get_int(settings, "max_lifetime");
+	cfg.min_scale =
+		(float)obs_data_get_double(settings, "min_scale");
+	cfg.max_scale =
+		(float)obs_data_get_double(settings, "max_scale");
+	cfg.preserve_aspect =
 		obs_data_get_bool(settings, "preserve_aspect");
-	data->min_rot = (float)obs_data_get_double(
-		settings, "min_rot");
-	data->max_rot = (float)obs_data_get_double(
-		settings, "max_rot");
-	data->disable_rot =
-		obs_data_get_bool(settings, "disable_rot");
-	data->volume_db = (float)obs_data_get_double(
-		settings, "volume_db");
-	data->use_compressor =
+	cfg.min_rot = (float)obs_data_get_double(settings, "min_rot");
+	cfg.max_rot = (float)obs_data_get_double(settings, "max_rot");
+	cfg.disable_rot = obs_data_get_bool(settings, "disable_rot");
+	cfg.spread_placement = strcmp(obs_data_get_string(
+					      settings, "placement"),
+				      "spread") == 0;
+	cfg.volume_db =
+		(float)obs_data_get_double(settings, "volume_db");
+	cfg.use_compressor =
 		obs_data_get_bool(settings, "use_compressor");
-	data->comp_threshold = (float)obs_data_get_double(
+	cfg.comp_threshold = (float)obs_data_get_double(
 		settings, "comp_threshold");
-	data->comp_ratio = (float)obs_data_get_double(
-		settings, "comp_ratio");
-	data->comp_attack = (float)obs_data_get_double(
-		settings, "comp_attack");
-	data->comp_release = (float)obs_data_get_double(
-		settings, "comp_release");
-	data->comp_output_gain = (float)obs_data_get_double(
+	cfg.comp_ratio =
+		(float)obs_data_get_double(settings, "comp_ratio");
+	cfg.comp_attack =
+		(float)obs_data_get_double(settings, "comp_attack");
+	cfg.comp_release =
+		(float)obs_data_get_double(settings, "comp_release");
+	cfg.comp_output_gain = (float)obs_data_get_double(
 		settings, "comp_output_gain");
-	data->use_limiter =
-		obs_data_get_bool(settings, "use_limiter");
-	data->limiter_threshold = (float)obs_data_get_double(
+	cfg.use_limiter = obs_data_get_bool(settings, "use_limiter");
+	cfg.limiter_threshold = (float)obs_data_get_double(
 		settings, "limiter_threshold");
-	data->spawn_count =
-		(int)obs_data_get_int(settings, "spawn_count");
-	data->max_active =
-		(int)obs_data_get_int(settings, "max_active");
+	const char *audio_mode =
+		obs_data_get_string(settings, "audio_mode");
+	cfg.use_audio_bus = strcmp(audio_mode, "shared_bus") == 0;
+	cfg.normalize_audio = strcmp(audio_mode, "normalize") == 0;
+	cfg.target_lufs =
+		(float)obs_data_get_double(settings, "target_lufs");
+	cfg.spawn_count = (int)obs_data_get_int(settings, "spawn_count");
+	cfg.max_active = (int)obs_data_get_int(settings, "max_active");
 
-	if (changed)
-		update_file_list(data);
+	const uint64_t MB = 1024 * 1024;
+	const char *policy =
+		obs_data_get_string(settings, "budget_policy");
+	cfg.budget_decoder =
+		(uint64_t)obs_data_get_int(settings, "budget_decoder_mb") *
+		MB;
+	cfg.budget_vram =
+		(uint64_t)obs_data_get_int(settings, "budget_vram_mb") * MB;
+	cfg.budget_pps =
+		(uint64_t)obs_data_get_int(settings, "budget_mpps") *
+		1000000;
+	if (strcmp(policy, "replace") == 0)
+		cfg.policy = budget_policy::replace;
+	else if (strcmp(policy, "drop") == 0)
+		cfg.policy = budget_policy::drop;
+	else
+		cfg.policy = budget_policy::queue;
+	cfg.pool_min = (int)obs_data_get_int(settings, "pool_min");
+	cfg.pool_max = (int)obs_data_get_int(settings, "pool_max");
+	cfg.lookahead = (int)obs_data_get_int(settings, "lookahead");
+	cfg.remote_prefetch =
+		(int)obs_data_get_int(settings, "remote_prefetch");
+	cfg.selection = strcmp(obs_data_get_string(settings,
+						   "selection"),
+			       "shuffle") == 0
+				? selection_engine::mode::shuffle
+				: selection_engine::mode::random;
+	const char *weighting = obs_data_get_string(settings, "weighting");
+	if (strcmp(weighting, "sidecar") == 0)
+		cfg.weighting = weight_source::sidecar;
+	else if (strcmp(weighting, "duration") == 0)
+		cfg.weighting = weight_source::duration;
+	else
+		cfg.weighting = weight_source::none;
+	cfg.use_proxies = obs_data_get_bool(settings, "use_proxies");
+	const char *decode = obs_data_get_string(settings, "decode_policy");
+	if (strcmp(decode, "auto") == 0)
+		cfg.decode = decode_policy::automatic;
+	else if (strcmp(decode, "hardware") == 0)
+		cfg.decode = decode_policy::hardware;
+	else
+		cfg.decode = decode_policy::software;
+	cfg.verbose_log = obs_data_get_bool(settings, "verbose_log");
+	cfg.frame_aligned =
+		obs_data_get_bool(settings, "frame_aligned");
+	cfg.rate_limit = obs_data_get_double(settings, "rate_limit");
+	cfg.rate_burst = (int)obs_data_get_int(settings, "rate_burst");
+	const char *storm = obs_data_get_string(settings, "storm_policy");
+	if (strcmp(storm, "queue") == 0)
+		cfg.storm = storm_policy::queue;
+	else if (strcmp(storm, "merge") == 0)
+		cfg.storm = storm_policy::merge;
+	else
+		cfg.storm = storm_policy::drop;
+	cfg.coalesce_ms = (int)obs_data_get_int(settings, "coalesce_ms");
+
+	source_config prev = config_of(data);
+	reselect |= cfg.selection != prev.selection ||
+		    cfg.weighting != prev.weighting;
+
+	// One swap; spawns already running keep their own copy
+	data->config.publish(source_config(cfg));
+	if (reselect)
+		data->select_gen++;
+	{
+		std::lock_guard<std::mutex> lk(data->queue_mutex);
+		data->bucket.configure(cfg.rate_limit, cfg.rate_burst,
+				       os_gettime_ns());
+	}
+	// The cache is shared; the last source updated sets it
+	remote_cache_set_limit(
+		(uint64_t)obs_data_get_int(settings, "remote_cache_mb") *
+		1024 * 1024);
+	// Likewise the hardware decode sessions
+	hw_set_limit((int)obs_data_get_int(settings, "hw_sessions"));
+
+	if (!data->warming)
+		pool_resize(data);
+
+	// The bus stays alive once created, items spawned onto it
+	// detach from it when they end
+	if (cfg.use_audio_bus && !data->bus)
+		data->bus = audio_bus_create();
+	if (data->bus)
+		apply_audio_filters(audio_bus_get_source(data->bus), cfg,
+				    cfg.use_audio_bus);
+
+	if (warm) {
+		blog(LOG_INFO,
+		     "[RandomMedia] Restoring %s from the snapshot",
+		     describe(lib).c_str());
+		publish_file_list(data, std::move(snapshot), lib);
+	} else if (changed) {
+		// Files of the old folder must not spawn while the
+		// new one is scanned
+		cancel_reload(data);
+		data->file_list.publish({});
+		lookahead_flush(data);
+		start_reload(data);
+		start_watcher(data);
+	} else {
+		// The box may have changed with the transform settings
+		file_list_t::reader files(data->file_list);
+		request_proxies(data, *files);
+	}
+	if (data->spawn_worker.joinable() && !data->warming)
+		request_lookahead_refill(data);
 }
 
 static obs_properties_t *source_properties(void *priv)
@@ -572,12 +4300,49 @@ static obs_properties_t *source_properties(void *priv)
 				"Media Folder",
 				OBS_PATH_DIRECTORY, nullptr,
 				nullptr);
+	obs_properties_add_editable_list(
+		props, "extra_folders", "Additional Folders",
+		OBS_EDITABLE_LIST_TYPE_STRINGS, nullptr, nullptr);
+	obs_properties_add_bool(props, "recursive",
+				"Include Subfolders");
+	obs_properties_add_path(
+		props, "manifest",
+		"Manifest file or URL (replaces folder scan)",
+		OBS_PATH_FILE,
+		"Manifests (*.txt *.m3u *.rmscat);;All Files (*.*)",
+		nullptr);
+	obs_properties_add_bool(
+		props, "warm_start",
+		"Start from the last file list (check folders later)");
+
+	// --- Selection ---
+	obs_property_t *selection = obs_properties_add_list(
+		props, "selection", "Selection", OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(selection, "Random (may repeat)",
+				     "random");
+	obs_property_list_add_string(
+		selection, "Shuffle (no repeats until all played)",
+		"shuffle");
+	obs_property_t *weighting = obs_properties_add_list(
+		props, "weighting", "Weights", OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(weighting, "None", "none");
+	obs_property_list_add_string(weighting, "From weights file",
+				     "sidecar");
+	obs_property_list_add_string(
+		weighting, "Equal screen time (favour short clips)",
+		"duration");
+	obs_properties_add_path(props, "weights_file",
+				"  Weights File (weight path per line)",
+				OBS_PATH_FILE,
+				"Text (*.txt);;All Files (*.*)", nullptr);
 
 	char info_buf[64] = "Files found: 0";
 	if (data)
 		snprintf(info_buf, sizeof(info_buf),
 			 "Files found: %zu",
-			 data->file_list.size());
+			 file_count(data));
 	obs_properties_add_text(props, "file_count_info",
 				info_buf, OBS_TEXT_INFO);
 	obs_properties_add_button2(props, "btn_reload",
@@ -589,6 +4354,20 @@ static obs_properties_t *source_properties(void *priv)
 		props, "volume_db", "Volume (dB)", -60.0, 0.0,
 		0.5);
 
+	obs_property_t *mode = obs_properties_add_list(
+		props, "audio_mode", "Audio Processing",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(mode, "Filters on each item",
+				     "per_item");
+	obs_property_list_add_string(mode,
+				     "Shared bus (one filter chain)",
+				     "shared_bus");
+	obs_property_list_add_string(
+		mode, "Normalize loudness (static gain)", "normalize");
+	obs_properties_add_float_slider(
+		props, "target_lufs", "  Normalize Target (LUFS)",
+		-40.0, -5.0, 0.5);
+
 	// Compressor group
 	obs_properties_add_bool(props, "use_compressor",
 				"Enable Compressor");
@@ -635,15 +4414,114 @@ static obs_properties_t *source_properties(void *priv)
 	obs_properties_add_float_slider(
 		props, "max_rot", "Max Rotation (deg)", -360.0,
 		360.0, 1.0);
+	obs_property_t *placement = obs_properties_add_list(
+		props, "placement", "Placement", OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(placement, "Random", "random");
+	obs_property_list_add_string(
+		placement, "Spread out (avoid overlaps)", "spread");
+
+	obs_property_t *render = obs_properties_add_list(
+		props, "render_mode", "Render Mode",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(render, "Overlay scene",
+				     "scene");
+	obs_property_list_add_string(
+		render, "Single-pass compositor (no scene items)",
+		"compositor");
 
 	// --- Playback ---
 	obs_properties_add_bool(props, "hide_on_end",
 				"Remove after playback ends");
+	obs_properties_add_float_slider(
+		props, "image_duration", "Image Display Time (s)",
+		0.5, 60.0, 0.5);
+	obs_properties_add_int(props, "max_lifetime",
+			       "Max Item Lifetime (s)", 5, 36000, 5);
 	obs_properties_add_int(props, "spawn_count",
-			       "Videos per Trigger", 1, 10, 1);
+			       "Videos per Trigger", 1, 500, 1);
 	obs_properties_add_int(props, "max_active",
-			       "Max Simultaneous Videos", 1, 20,
+			       "Max Simultaneous Videos", 1,
+			       (int)ITEM_SLOTS, 1);
+	obs_properties_add_bool(props, "frame_aligned",
+				"Apply Spawns Once per Frame");
+
+	// --- Performance ---
+	obs_properties_add_int(props, "pool_min",
+			       "Pre-warmed Sources (pool min)", 0,
+			       20, 1);
+	obs_properties_add_int(props, "pool_max",
+			       "Idle Sources Kept (pool max)", 0, 40,
 			       1);
+	obs_properties_add_int(props, "lookahead",
+			       "Pre-opened Next Clips (lookahead)", 0,
+			       10, 1);
+	obs_properties_add_bool(
+		props, "use_proxies",
+		"Play oversized clips from downscaled proxies");
+	obs_property_t *decode = obs_properties_add_list(
+		props, "decode_policy", "Decoding", OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(decode, "Software", "software");
+	obs_property_list_add_string(
+		decode, "Hardware for supported codecs", "auto");
+	obs_property_list_add_string(decode, "Hardware for all clips",
+				     "hardware");
+	obs_properties_add_int(props, "hw_sessions",
+			       "Hardware Decode Sessions (all sources)",
+			       0, 64, 1);
+	obs_properties_add_int(props, "remote_prefetch",
+			       "Remote Clips Downloaded Ahead", 1, 64,
+			       1);
+	obs_properties_add_int(props, "remote_cache_mb",
+			       "Remote Cache Size (MB, all sources)",
+			       64, 1024 * 1024, 64);
+
+	// --- Resource budget ---
+	obs_properties_add_int(props, "budget_decoder_mb",
+			       "Decoder Memory Budget (MB, 0 = off)", 0,
+			       65536, 64);
+	obs_properties_add_int(props, "budget_vram_mb",
+			       "VRAM Budget (MB, 0 = off)", 0, 65536,
+			       64);
+	obs_properties_add_int(props, "budget_mpps",
+			       "Decode Budget (Mpixels/s, 0 = off)", 0,
+			       10000, 10);
+	obs_property_t *policy = obs_properties_add_list(
+		props, "budget_policy", "When Over Budget",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(policy,
+				     "Queue until items finish", "queue");
+	obs_property_list_add_string(policy,
+				     "Replace with a cheaper clip",
+				     "replace");
+	obs_property_list_add_string(policy, "Drop", "drop");
+
+	// --- Trigger storms ---
+	obs_properties_add_float(props, "rate_limit",
+				 "Triggers per Second (0 = unlimited)",
+				 0.0, 1000.0, 0.5);
+	obs_properties_add_int(props, "rate_burst",
+			       "Trigger Burst Size", 1, 500, 1);
+	obs_property_t *storm = obs_properties_add_list(
+		props, "storm_policy", "When Over the Limit",
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(storm, "Drop", "drop");
+	obs_property_list_add_string(
+		storm, "Queue (also waits for Max Simultaneous)",
+		"queue");
+	obs_property_list_add_string(
+		storm, "Merge into the next queued spawn", "merge");
+	obs_properties_add_int(props, "coalesce_ms",
+			       "Coalesce Triggers Within (ms, 0 = off)",
+			       0, 2000, 10);
+
+	// --- Diagnostics ---
+	obs_properties_add_bool(props, "verbose_log",
+				"Log Every Spawn (verbose)");
+	obs_properties_add_button2(props, "btn_export_trace",
+				   "Export Trace (Chrome / Perfetto)",
+				   btn_export_trace, data);
 
 	// --- Test ---
 	obs_properties_add_button2(props, "btn_spawn",
@@ -667,12 +4545,42 @@ static void source_defaults(obs_data_t *settings)
 				    30.0);
 	obs_data_set_default_bool(settings, "hide_on_end",
 				  true);
+	obs_data_set_default_double(settings, "image_duration",
+				    5.0);
+	obs_data_set_default_int(settings, "max_lifetime", 300);
+	obs_data_set_default_string(settings, "render_mode", "scene");
 	obs_data_set_default_bool(settings, "random_transform",
 				  true);
+	obs_data_set_default_string(settings, "placement", "random");
+	obs_data_set_default_bool(settings, "warm_start", true);
+	obs_data_set_default_string(settings, "selection", "random");
+	obs_data_set_default_string(settings, "weighting", "none");
 	obs_data_set_default_int(settings, "spawn_count", 1);
 	obs_data_set_default_int(settings, "max_active", 5);
+	obs_data_set_default_bool(settings, "frame_aligned", false);
+	obs_data_set_default_int(settings, "pool_min", 2);
+	obs_data_set_default_int(settings, "pool_max", 8);
+	obs_data_set_default_int(settings, "lookahead", 2);
+	obs_data_set_default_int(settings, "remote_prefetch", 8);
+	obs_data_set_default_int(settings, "remote_cache_mb", 2048);
+	obs_data_set_default_bool(settings, "use_proxies", false);
+	obs_data_set_default_string(settings, "decode_policy",
+				    "software");
+	obs_data_set_default_int(settings, "hw_sessions", 8);
+	obs_data_set_default_bool(settings, "verbose_log", false);
+	obs_data_set_default_int(settings, "budget_decoder_mb", 0);
+	obs_data_set_default_int(settings, "budget_vram_mb", 0);
+	obs_data_set_default_int(settings, "budget_mpps", 0);
+	obs_data_set_default_string(settings, "budget_policy", "queue");
+	obs_data_set_default_double(settings, "rate_limit", 0.0);
+	obs_data_set_default_int(settings, "rate_burst", 10);
+	obs_data_set_default_string(settings, "storm_policy", "drop");
+	obs_data_set_default_int(settings, "coalesce_ms", 0);
 	obs_data_set_default_double(settings, "volume_db",
 				    -6.0);
+	obs_data_set_default_string(settings, "audio_mode",
+				    "per_item");
+	obs_data_set_default_double(settings, "target_lufs", -18.0);
 	obs_data_set_default_bool(settings, "use_compressor",
 				  true);
 	obs_data_set_default_double(settings, "comp_threshold",
@@ -690,13 +4598,151 @@ static void source_defaults(obs_data_t *settings)
 				    "limiter_threshold", -1.0);
 }
 
+// ============================================================
+//  Overlay rendering
+// ============================================================
+// Items live in a private scene owned by the source, which is
+// drawn at canvas size wherever the Random Media Source is
+// placed. The user's scenes are never edited, and a scene
+// switch only changes where the overlay is shown.
 static uint32_t source_get_width(void *)
 {
-	return 1;
+	struct obs_video_info ovi = {};
+	return obs_get_video_info(&ovi) ? ovi.base_width : 0;
 }
+
 static uint32_t source_get_height(void *)
 {
-	return 1;
+	struct obs_video_info ovi = {};
+	return obs_get_video_info(&ovi) ? ovi.base_height : 0;
+}
+
+// Compositor items are drawn after the overlay, oldest first,
+// under one blend state: each is a matrix push and a draw, with
+// none of the scene's per-item state changes.
+static void source_video_render(void *d, gs_effect_t * /*effect*/)
+{
+	auto *data = static_cast<random_media_data *>(d);
+	obs_source_video_render(obs_scene_get_source(data->overlay));
+
+	std::lock_guard<std::mutex> lk(data->comp_mutex);
+	if (data->comp_items.empty())
+		return;
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	for (const comp_item &c : data->comp_items) {
+		gs_matrix_push();
+		gs_matrix_translate3f(c.xf.pos.x, c.xf.pos.y, 0.0f);
+		gs_matrix_rotaa4f(0.0f, 0.0f, 1.0f, RAD(c.xf.rot));
+		gs_matrix_scale3f(c.xf.scale.x, c.xf.scale.y, 1.0f);
+		obs_source_video_render(c.media);
+		gs_matrix_pop();
+	}
+	gs_blend_state_pop();
+}
+
+// Activating the source activates the overlay and every item
+// in it, so media only plays while the overlay is on air
+static void source_enum_sources(void *d,
+				obs_source_enum_proc_t enum_callback,
+				void *param)
+{
+	auto *data = static_cast<random_media_data *>(d);
+	enum_callback(data->source, obs_scene_get_source(data->overlay),
+		      param);
+
+	std::vector<obs_source_t *> children;
+	{
+		std::lock_guard<std::mutex> lk(data->comp_mutex);
+		for (const comp_item &c : data->comp_items)
+			children.push_back(obs_source_get_ref(c.media));
+	}
+	for (obs_source_t *child : children) {
+		if (child)
+			enum_callback(data->source, child, param);
+		obs_source_release(child);
+	}
+}
+
+static void mix_child_audio(obs_source_t *child, uint64_t min_ts,
+			    struct obs_source_audio_mix *audio_output,
+			    uint32_t mixers, size_t channels,
+			    size_t sample_rate)
+{
+	uint64_t ts = obs_source_get_audio_timestamp(child);
+	if (!ts)
+		return;
+	size_t offset = (size_t)((ts - min_ts) * sample_rate /
+				 1000000000ULL);
+	if (offset >= AUDIO_OUTPUT_FRAMES)
+		return;
+
+	struct obs_source_audio_mix child_audio;
+	obs_source_get_audio_mix(child, &child_audio);
+	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; ++mix) {
+		if ((mixers & (1 << mix)) == 0)
+			continue;
+		for (size_t ch = 0; ch < channels; ++ch) {
+			float *out = audio_output->output[mix].data[ch];
+			const float *in =
+				child_audio.output[mix].data[ch];
+			for (size_t i = offset; i < AUDIO_OUTPUT_FRAMES;
+			     ++i)
+				out[i] += in[i - offset];
+		}
+	}
+}
+
+// Mixes the overlay and any compositor items the way a scene
+// mixes its children: aligned to the earliest timestamp
+static bool source_audio_render(void *d, uint64_t *ts_out,
+				struct obs_source_audio_mix *audio_output,
+				uint32_t mixers, size_t channels,
+				size_t sample_rate)
+{
+	auto *data = static_cast<random_media_data *>(d);
+	std::vector<obs_source_t *> children;
+	children.push_back(
+		obs_source_get_ref(obs_scene_get_source(data->overlay)));
+	{
+		std::lock_guard<std::mutex> lk(data->comp_mutex);
+		for (const comp_item &c : data->comp_items)
+			children.push_back(obs_source_get_ref(c.media));
+	}
+
+	uint64_t min_ts = 0;
+	for (obs_source_t *child : children) {
+		if (!child || !obs_source_audio_active(child) ||
+		    obs_source_audio_pending(child))
+			continue;
+		uint64_t ts = obs_source_get_audio_timestamp(child);
+		if (ts && (!min_ts || ts < min_ts))
+			min_ts = ts;
+	}
+
+	if (min_ts) {
+		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; ++mix) {
+			if ((mixers & (1 << mix)) == 0)
+				continue;
+			for (size_t ch = 0; ch < channels; ++ch)
+				memset(audio_output->output[mix].data[ch],
+				       0,
+				       AUDIO_OUTPUT_FRAMES * sizeof(float));
+		}
+		for (obs_source_t *child : children)
+			if (child && obs_source_audio_active(child) &&
+			    !obs_source_audio_pending(child))
+				mix_child_audio(child, min_ts, audio_output,
+						mixers, channels,
+						sample_rate);
+	}
+
+	for (obs_source_t *child : children)
+		obs_source_release(child);
+	if (!min_ts)
+		return false;
+	*ts_out = min_ts;
+	return true;
 }
 
 // ============================================================
@@ -706,36 +4752,56 @@ static struct obs_source_info random_media_info = {};
 
 bool obs_module_load(void)
 {
+	media_index_init();
+	proxy_cache_init();
+	remote_cache_init();
+
 	random_media_info.id = "random_media_source";
 	random_media_info.type = OBS_SOURCE_TYPE_INPUT;
 	random_media_info.output_flags =
-		OBS_SOURCE_DO_NOT_DUPLICATE;
+		OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+		OBS_SOURCE_COMPOSITE | OBS_SOURCE_DO_NOT_DUPLICATE;
 	random_media_info.get_name = source_get_name;
 	random_media_info.create = source_create;
 	random_media_info.destroy = source_destroy;
 	random_media_info.get_width = source_get_width;
 	random_media_info.get_height = source_get_height;
+	random_media_info.video_render = source_video_render;
+	random_media_info.enum_active_sources = source_enum_sources;
+	random_media_info.enum_all_sources = source_enum_sources;
+	random_media_info.audio_render = source_audio_render;
 	random_media_info.get_properties = source_properties;
 	random_media_info.get_defaults = source_defaults;
 	random_media_info.update = source_update;
 
 	obs_register_source(&random_media_info);
+	audio_bus_register();
+	image_source_register();
 
 	// Register hotkey for Streamer.bot TriggerHotkeyByName
-	g_hotkey_spawn = obs_hotkey_register_frontend(
-		"random_media_spawn",
-		"Random Media: Spawn",
-		hotkey_spawn_cb, nullptr);
+	obs_hotkey_register_frontend("random_media_spawn",
+				     "Random Media: Spawn (first source)",
+				     hotkey_compat_spawn_cb, nullptr);
 	blog(LOG_INFO,
 	     "[RandomMedia] Plugin loaded"
 	     " — id: random_media_source"
-	     " — hotkey: random_media_spawn");
+	     " — hotkey: random_media_spawn (frontend and per source)");
 	return true;
 }
 
+void obs_module_unload(void)
+{
+	warm_stop_thread();
+	remote_cache_free();
+	proxy_cache_free();
+	media_index_free();
+	trace_free();
+}
+
 void obs_module_post_load(void)
 {
 	blog(LOG_INFO,
 	     "[RandomMedia] post_load: attempting vendor reg...");
 	try_register_vendor();
+	warm_start_thread();
 }
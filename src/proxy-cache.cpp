@@ -0,0 +1,625 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "proxy-cache.h"
+#include "media-index.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+// A proxy is only worth making when it at least halves the
+// pixels decoded per frame
+static constexpr double MAX_PROXY_FACTOR = 0.7;
+
+enum class proxy_state { pending, ready, skipped, failed };
+
+struct proxy_entry {
+	int64_t mtime = 0;
+	int64_t size = 0;
+	proxy_state state = proxy_state::pending;
+	proxy_info proxy;
+};
+
+struct proxy_job {
+	std::string key;
+	std::string file;
+	uint32_t max_w;
+	uint32_t max_h;
+};
+
+static struct {
+	std::shared_mutex mutex; // shared by spawn-path lookups
+	std::condition_variable_any cv;
+	std::unordered_map<std::string, proxy_entry> entries;
+	std::deque<proxy_job> queue;
+	std::thread worker;
+	std::atomic<bool> stop{false};
+	std::string dir;
+} s_proxy;
+
+static std::string entry_key(const std::string &file, uint32_t max_w,
+			     uint32_t max_h)
+{
+	return file + "|" + std::to_string(max_w) + "x" +
+	       std::to_string(max_h);
+}
+
+// FNV-1a, so proxy names stay the same across runs and builds
+static uint64_t path_hash(const std::string &s)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : s) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+static std::string hash_prefix(const std::string &file)
+{
+	char buf[24];
+	snprintf(buf, sizeof(buf), "%016llx-",
+		 (unsigned long long)path_hash(file));
+	return buf;
+}
+
+// <hash>-<mtime>-<size>-<box>.mkv
+static std::string proxy_path(const std::string &file, int64_t mtime,
+			      int64_t size, uint32_t max_w,
+			      uint32_t max_h)
+{
+	return s_proxy.dir + "/" + hash_prefix(file) +
+	       std::to_string(mtime) + "-" + std::to_string(size) +
+	       "-" + std::to_string(max_w) + "x" +
+	       std::to_string(max_h) + ".mkv";
+}
+
+// The smallest even size that still covers the box, or false
+// if the source is not enough larger than it
+static bool proxy_size(uint32_t src_w, uint32_t src_h, uint32_t max_w,
+		       uint32_t max_h, uint32_t &w, uint32_t &h)
+{
+	if (!src_w || !src_h || !max_w)
+		return false;
+	double f = (double)max_w / src_w;
+	if (max_h)
+		f = std::max(f, (double)max_h / src_h);
+	if (f > MAX_PROXY_FACTOR)
+		return false;
+	w = std::max(2u, (uint32_t)std::lround(src_w * f) & ~1u);
+	h = std::max(2u, (uint32_t)std::lround(src_h * f) & ~1u);
+	return true;
+}
+
+static void lower_thread_priority(void)
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+	// Linux applies nice values per thread
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#endif
+}
+
+// Stale proxies of an edited file are never looked up again
+static void remove_stale(const std::string &file,
+			 const std::string &keep)
+{
+	std::string prefix = hash_prefix(file);
+	os_dir_t *d = os_opendir(s_proxy.dir.c_str());
+	if (!d)
+		return;
+	std::string keep_name = keep.substr(keep.rfind('/') + 1);
+	size_t key_len = keep_name.rfind('-'); // up to the box
+	struct os_dirent *ent;
+	while ((ent = os_readdir(d))) {
+		if (ent->directory ||
+		    strncmp(ent->d_name, prefix.c_str(), prefix.size()) !=
+			    0 ||
+		    strncmp(ent->d_name, keep_name.c_str(), key_len) == 0)
+			continue;
+		std::string old = s_proxy.dir + "/" + ent->d_name;
+		os_unlink(old.c_str());
+	}
+	os_closedir(d);
+}
+
+// ============================================================
+//  Transcode
+// ============================================================
+// Video is decoded, scaled and re-encoded; audio is copied as
+// is. Output goes to a .part file renamed into place when
+// complete, so a proxy on disk is always whole.
+struct transcoder {
+	AVFormatContext *in = nullptr;
+	AVFormatContext *out = nullptr;
+	AVCodecContext *dec = nullptr;
+	AVCodecContext *enc = nullptr;
+	SwsContext *sws = nullptr;
+	AVFrame *frame = nullptr;
+	AVFrame *scaled = nullptr;
+	AVPacket *pkt = nullptr;
+	AVPacket *enc_pkt = nullptr;
+	int vi = -1;
+	int ai = -1;
+	int out_ai = -1;
+	int64_t last_pts = AV_NOPTS_VALUE;
+};
+
+static void transcoder_free(transcoder &t)
+{
+	sws_freeContext(t.sws);
+	av_frame_free(&t.frame);
+	av_frame_free(&t.scaled);
+	av_packet_free(&t.pkt);
+	av_packet_free(&t.enc_pkt);
+	avcodec_free_context(&t.dec);
+	avcodec_free_context(&t.enc);
+	if (t.out) {
+		if (t.out->pb)
+			avio_closep(&t.out->pb);
+		avformat_free_context(t.out);
+	}
+	avformat_close_input(&t.in);
+}
+
+static bool has_alpha(const AVStream *st)
+{
+	const AVPixFmtDescriptor *desc =
+		av_pix_fmt_desc_get((AVPixelFormat)st->codecpar->format);
+	if (desc && (desc->flags & AV_PIX_FMT_FLAG_ALPHA))
+		return true;
+	// VP8/VP9 carry alpha as side data, flagged in metadata
+	AVDictionaryEntry *e =
+		av_dict_get(st->metadata, "alpha_mode", nullptr, 0);
+	return e && strcmp(e->value, "1") == 0;
+}
+
+static const AVCodec *find_video_encoder(void)
+{
+	const AVCodec *c = avcodec_find_encoder_by_name("libx264");
+	if (!c)
+		c = avcodec_find_encoder(AV_CODEC_ID_H264);
+	if (!c)
+		c = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+	return c;
+}
+
+static bool open_codecs(transcoder &t, uint32_t w, uint32_t h,
+			const char *part)
+{
+	AVStream *vst = t.in->streams[t.vi];
+	const AVCodec *dcodec =
+		avcodec_find_decoder(vst->codecpar->codec_id);
+	const AVCodec *ecodec = find_video_encoder();
+	if (!dcodec || !ecodec)
+		return false;
+
+	t.dec = avcodec_alloc_context3(dcodec);
+	if (!t.dec ||
+	    avcodec_parameters_to_context(t.dec, vst->codecpar) < 0)
+		return false;
+	t.dec->thread_count = 1;
+	t.dec->pkt_timebase = vst->time_base;
+	if (avcodec_open2(t.dec, dcodec, nullptr) < 0)
+		return false;
+
+	if (avformat_alloc_output_context2(&t.out, nullptr, "matroska",
+					   part) < 0)
+		return false;
+
+	AVRational fps = av_guess_frame_rate(t.in, vst, nullptr);
+	if (fps.num <= 0 || fps.den <= 0)
+		fps = {30, 1};
+
+	t.enc = avcodec_alloc_context3(ecodec);
+	if (!t.enc)
+		return false;
+	t.enc->width = (int)w;
+	t.enc->height = (int)h;
+	t.enc->pix_fmt = AV_PIX_FMT_YUV420P;
+	t.enc->time_base = av_inv_q(fps);
+	t.enc->framerate = fps;
+	t.enc->sample_aspect_ratio = t.dec->sample_aspect_ratio;
+	t.enc->gop_size = (int)std::min(300.0, 2.0 * av_q2d(fps));
+	t.enc->thread_count = 1;
+	// ~0.1 bits per pixel at 30 fps; x264 uses CRF instead
+	t.enc->bit_rate = (int64_t)w * h * 3;
+	if (t.out->oformat->flags & AVFMT_GLOBALHEADER)
+		t.enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+	AVDictionary *opts = nullptr;
+	if (ecodec->id == AV_CODEC_ID_H264) {
+		av_dict_set(&opts, "preset", "veryfast", 0);
+		av_dict_set(&opts, "crf", "23", 0);
+	}
+	int ret = avcodec_open2(t.enc, ecodec, &opts);
+	av_dict_free(&opts);
+	return ret >= 0;
+}
+
+static bool open_output(transcoder &t, const char *part)
+{
+	AVStream *vo = avformat_new_stream(t.out, nullptr);
+	if (!vo ||
+	    avcodec_parameters_from_context(vo->codecpar, t.enc) < 0)
+		return false;
+	vo->time_base = t.enc->time_base;
+
+	if (t.ai >= 0) {
+		AVStream *ao = avformat_new_stream(t.out, nullptr);
+		if (!ao || avcodec_parameters_copy(
+				   ao->codecpar,
+				   t.in->streams[t.ai]->codecpar) < 0)
+			return false;
+		ao->codecpar->codec_tag = 0;
+		ao->time_base = t.in->streams[t.ai]->time_base;
+		t.out_ai = ao->index;
+	}
+
+	if (avio_open(&t.out->pb, part, AVIO_FLAG_WRITE) < 0)
+		return false;
+	return avformat_write_header(t.out, nullptr) >= 0;
+}
+
+// nullptr flushes the encoder
+static bool encode_frame(transcoder &t, AVFrame *frame)
+{
+	if (avcodec_send_frame(t.enc, frame) < 0)
+		return false;
+	for (;;) {
+		int ret = avcodec_receive_packet(t.enc, t.enc_pkt);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+			return true;
+		if (ret < 0)
+			return false;
+		av_packet_rescale_ts(t.enc_pkt, t.enc->time_base,
+				     t.out->streams[0]->time_base);
+		t.enc_pkt->stream_index = 0;
+		if (av_interleaved_write_frame(t.out, t.enc_pkt) < 0)
+			return false;
+	}
+}
+
+static bool scale_frame(transcoder &t, const AVFrame *src)
+{
+	t.sws = sws_getCachedContext(
+		t.sws, src->width, src->height,
+		(AVPixelFormat)src->format, t.enc->width,
+		t.enc->height, AV_PIX_FMT_YUV420P, SWS_BILINEAR,
+		nullptr, nullptr, nullptr);
+	if (!t.sws || av_frame_make_writable(t.scaled) < 0)
+		return false;
+	sws_scale(t.sws, src->data, src->linesize, 0, src->height,
+		  t.scaled->data, t.scaled->linesize);
+
+	// The encoder needs strictly increasing timestamps, which
+	// variable frame rate input does not always map to
+	int64_t pts = src->best_effort_timestamp;
+	pts = pts == AV_NOPTS_VALUE
+		      ? (t.last_pts == AV_NOPTS_VALUE ? 0
+						      : t.last_pts + 1)
+		      : av_rescale_q(pts,
+				     t.in->streams[t.vi]->time_base,
+				     t.enc->time_base);
+	if (t.last_pts != AV_NOPTS_VALUE && pts <= t.last_pts)
+		pts = t.last_pts + 1;
+	t.last_pts = pts;
+	t.scaled->pts = pts;
+	return encode_frame(t, t.scaled);
+}
+
+// nullptr flushes the decoder
+static bool decode_packet(transcoder &t, const AVPacket *pkt)
+{
+	int ret = avcodec_send_packet(t.dec, pkt);
+	if (ret < 0 && ret != AVERROR_INVALIDDATA)
+		return false;
+	for (;;) {
+		ret = avcodec_receive_frame(t.dec, t.frame);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+			return true;
+		if (ret < 0)
+			return false;
+		bool ok = scale_frame(t, t.frame);
+		av_frame_unref(t.frame);
+		if (!ok)
+			return false;
+	}
+}
+
+static bool run_transcode(transcoder &t)
+{
+	while (!s_proxy.stop) {
+		int ret = av_read_frame(t.in, t.pkt);
+		if (ret == AVERROR_EOF)
+			break;
+		if (ret < 0)
+			return false;
+
+		bool ok = true;
+		if (t.pkt->stream_index == t.vi) {
+			ok = decode_packet(t, t.pkt);
+		} else if (t.pkt->stream_index == t.ai) {
+			av_packet_rescale_ts(
+				t.pkt, t.in->streams[t.ai]->time_base,
+				t.out->streams[t.out_ai]->time_base);
+			t.pkt->stream_index = t.out_ai;
+			t.pkt->pos = -1;
+			ok = av_interleaved_write_frame(t.out, t.pkt) >= 0;
+		}
+		av_packet_unref(t.pkt);
+		if (!ok)
+			return false;
+	}
+	if (s_proxy.stop)
+		return false;
+	return decode_packet(t, nullptr) && encode_frame(t, nullptr) &&
+	       av_write_trailer(t.out) >= 0;
+}
+
+// ============================================================
+//  Worker
+// ============================================================
+static bool stat_file(const char *file, int64_t &mtime, int64_t &size)
+{
+	struct stat st = {};
+	if (os_stat(file, &st) != 0)
+		return false;
+	mtime = (int64_t)st.st_mtime;
+	size = (int64_t)st.st_size;
+	return true;
+}
+
+static void finish_job(const proxy_job &job, int64_t mtime,
+		       int64_t size, proxy_state state,
+		       const proxy_info &proxy)
+{
+	std::lock_guard<std::shared_mutex> lk(s_proxy.mutex);
+	proxy_entry &e = s_proxy.entries[job.key];
+	e.mtime = mtime;
+	e.size = size;
+	e.state = state;
+	e.proxy = proxy;
+}
+
+static void process_job(const proxy_job &job)
+{
+	int64_t mtime = 0, size = 0;
+	if (!stat_file(job.file.c_str(), mtime, size)) {
+		finish_job(job, 0, 0, proxy_state::failed, {});
+		return;
+	}
+
+	transcoder t;
+	if (avformat_open_input(&t.in, job.file.c_str(), nullptr,
+				nullptr) < 0 ||
+	    avformat_find_stream_info(t.in, nullptr) < 0) {
+		transcoder_free(t);
+		finish_job(job, mtime, size, proxy_state::failed, {});
+		return;
+	}
+	t.vi = av_find_best_stream(t.in, AVMEDIA_TYPE_VIDEO, -1, -1,
+				   nullptr, 0);
+	t.ai = av_find_best_stream(t.in, AVMEDIA_TYPE_AUDIO, -1, t.vi,
+				   nullptr, 0);
+
+	// Transparent clips would lose their alpha in a YUV 4:2:0
+	// proxy, and GIFs are small anyway
+	uint32_t w = 0, h = 0;
+	const AVStream *vst = t.vi >= 0 ? t.in->streams[t.vi] : nullptr;
+	if (!vst || has_alpha(vst) ||
+	    vst->codecpar->codec_id == AV_CODEC_ID_GIF ||
+	    !proxy_size((uint32_t)vst->codecpar->width,
+			(uint32_t)vst->codecpar->height, job.max_w,
+			job.max_h, w, h)) {
+		transcoder_free(t);
+		finish_job(job, mtime, size, proxy_state::skipped, {});
+		return;
+	}
+
+	proxy_info proxy;
+	proxy.path = proxy_path(job.file, mtime, size, job.max_w,
+				job.max_h);
+	proxy.width = w;
+	proxy.height = h;
+
+	// Made by an earlier session
+	if (os_file_exists(proxy.path.c_str())) {
+		transcoder_free(t);
+		finish_job(job, mtime, size, proxy_state::ready, proxy);
+		return;
+	}
+
+	std::string part = proxy.path + ".part";
+	uint64_t start = os_gettime_ns();
+	bool ok = open_codecs(t, w, h, part.c_str()) &&
+		  open_output(t, part.c_str());
+	if (ok) {
+		t.frame = av_frame_alloc();
+		t.scaled = av_frame_alloc();
+		t.pkt = av_packet_alloc();
+		t.enc_pkt = av_packet_alloc();
+		ok = t.frame && t.scaled && t.pkt && t.enc_pkt;
+	}
+	if (ok) {
+		t.scaled->format = AV_PIX_FMT_YUV420P;
+		t.scaled->width = (int)w;
+		t.scaled->height = (int)h;
+		ok = av_frame_get_buffer(t.scaled, 0) >= 0 &&
+		     run_transcode(t);
+	}
+	transcoder_free(t);
+
+	if (!ok || os_rename(part.c_str(), proxy.path.c_str()) != 0) {
+		os_unlink(part.c_str());
+		if (!s_proxy.stop)
+			blog(LOG_WARNING,
+			     "[RandomMedia] Proxy transcode failed: %s",
+			     job.file.c_str());
+		finish_job(job, mtime, size, proxy_state::failed, {});
+		return;
+	}
+	remove_stale(job.file, proxy.path);
+	blog(LOG_INFO, "[RandomMedia] Proxy %ux%u ready in %.1f s: %s",
+	     w, h, (double)(os_gettime_ns() - start) / 1e9,
+	     job.file.c_str());
+	finish_job(job, mtime, size, proxy_state::ready, proxy);
+}
+
+static void proxy_worker_loop(void)
+{
+	os_set_thread_name("random-media: proxy");
+	lower_thread_priority();
+
+	std::unique_lock<std::shared_mutex> lk(s_proxy.mutex);
+	for (;;) {
+		s_proxy.cv.wait(lk, [] {
+			return s_proxy.stop || !s_proxy.queue.empty();
+		});
+		if (s_proxy.stop)
+			break;
+
+		proxy_job job = std::move(s_proxy.queue.front());
+		s_proxy.queue.pop_front();
+		lk.unlock();
+		process_job(job);
+		lk.lock();
+	}
+}
+
+// ============================================================
+//  Public API
+// ============================================================
+void proxy_cache_init(void)
+{
+	char *dir = obs_module_config_path("proxies");
+	if (dir) {
+		os_mkdirs(dir);
+		s_proxy.dir = dir;
+		bfree(dir);
+	}
+	s_proxy.stop = false;
+	s_proxy.worker = std::thread(proxy_worker_loop);
+}
+
+void proxy_cache_free(void)
+{
+	{
+		std::lock_guard<std::shared_mutex> lk(s_proxy.mutex);
+		s_proxy.stop = true;
+	}
+	s_proxy.cv.notify_all();
+	if (s_proxy.worker.joinable())
+		s_proxy.worker.join();
+
+	std::lock_guard<std::shared_mutex> lk(s_proxy.mutex);
+	s_proxy.entries.clear();
+	s_proxy.queue.clear();
+}
+
+void proxy_cache_request(const std::string &file, uint32_t max_w,
+			 uint32_t max_h)
+{
+	if (s_proxy.dir.empty() || !max_w)
+		return;
+
+	// Probed files that already fit are settled without the
+	// worker ever opening them
+	media_info info;
+	bool probed = media_index_lookup(file, info);
+	uint32_t w, h;
+	if (probed && info.has_video &&
+	    !proxy_size(info.width, info.height, max_w, max_h, w, h))
+		return;
+
+	std::string key = entry_key(file, max_w, max_h);
+	{
+		std::lock_guard<std::shared_mutex> lk(s_proxy.mutex);
+		auto it = s_proxy.entries.find(key);
+		if (it != s_proxy.entries.end()) {
+			const proxy_entry &e = it->second;
+			if (e.state == proxy_state::pending ||
+			    !probed ||
+			    (e.mtime == info.mtime && e.size == info.size))
+				return;
+		}
+		s_proxy.entries[key] = proxy_entry();
+		s_proxy.queue.push_back({key, file, max_w, max_h});
+	}
+	s_proxy.cv.notify_one();
+}
+
+bool proxy_cache_lookup(const std::string &file, uint32_t max_w,
+			uint32_t max_h, proxy_info &out)
+{
+	// The index holds the file's current mtime and size
+	media_info info;
+	if (!media_index_lookup(file, info))
+		return false;
+
+	std::shared_lock<std::shared_mutex> lk(s_proxy.mutex);
+	auto it = s_proxy.entries.find(entry_key(file, max_w, max_h));
+	if (it == s_proxy.entries.end())
+		return false;
+	const proxy_entry &e = it->second;
+	if (e.state != proxy_state::ready || e.mtime != info.mtime ||
+	    e.size != info.size)
+		return false;
+	out = e.proxy;
+	return true;
+}
+
+void proxy_cache_stats(size_t &ready, size_t &pending)
+{
+	ready = pending = 0;
+	std::lock_guard<std::shared_mutex> lk(s_proxy.mutex);
+	for (const auto &kv : s_proxy.entries) {
+		if (kv.second.state == proxy_state::ready)
+			ready++;
+		else if (kv.second.state == proxy_state::pending)
+			pending++;
+	}
+}
@@ -0,0 +1,56 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ============================================================
+//  Proxy cache
+// ============================================================
+// Clips much larger than they are ever shown are transcoded by
+// a low-priority worker into a scaled-down copy in the module
+// config directory. Proxies are keyed like the media index —
+// path, mtime and size — plus the display box they were made
+// for, so an edited file or a new max size gets a new proxy.
+//
+// A box is the largest size an item is drawn at; 'max_h' of 0
+// means only the width matters (aspect-preserving scaling).
+struct proxy_info {
+	std::string path;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// Starts the transcode worker
+void proxy_cache_init(void);
+// Stops the worker, abandoning any transcode in progress
+void proxy_cache_free(void);
+
+// Queues 'file' for transcoding unless it already fits the box
+// or has a proxy
+void proxy_cache_request(const std::string &file, uint32_t max_w,
+			 uint32_t max_h);
+
+// The ready proxy of 'file' for this box; false while there is
+// none or the file changed since it was made
+bool proxy_cache_lookup(const std::string &file, uint32_t max_w,
+			uint32_t max_h, proxy_info &out);
+
+void proxy_cache_stats(size_t &ready, size_t &pending);
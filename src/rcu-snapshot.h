@@ -0,0 +1,103 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// ============================================================
+//  RCU snapshot
+// ============================================================
+// Immutable value published through an atomic pointer. Readers
+// pin the current snapshot with a 'reader' guard and never take
+// a lock; writers build a new value, swap it in, and wait for
+// readers of the old epoch to leave before freeing it.
+//
+// Grace periods use two reader counters. A reader registers on
+// the current epoch and re-checks it, so a reader counted on an
+// epoch can only hold a snapshot that was current during it.
+template<typename T> class rcu_snapshot {
+public:
+	rcu_snapshot() : current(new T()) {}
+	~rcu_snapshot() { delete current.load(); }
+
+	rcu_snapshot(const rcu_snapshot &) = delete;
+	rcu_snapshot &operator=(const rcu_snapshot &) = delete;
+
+	class reader {
+	public:
+		explicit reader(const rcu_snapshot &s) : snap(s)
+		{
+			for (;;) {
+				slot = snap.epoch.load();
+				snap.readers[slot]++;
+				if (snap.epoch.load() == slot)
+					break;
+				snap.readers[slot]--;
+			}
+			ptr = snap.current.load();
+		}
+		~reader() { snap.readers[slot]--; }
+
+		reader(const reader &) = delete;
+		reader &operator=(const reader &) = delete;
+
+		const T &operator*() const { return *ptr; }
+		const T *operator->() const { return ptr; }
+
+	private:
+		const rcu_snapshot &snap;
+		const T *ptr = nullptr;
+		uint32_t slot = 0;
+	};
+
+	// Replaces the snapshot; blocks only the writer
+	void publish(T &&next)
+	{
+		std::lock_guard<std::mutex> lk(writer_mutex);
+		swap_in(new T(std::move(next)));
+	}
+
+	// Copy-on-write edit of the current snapshot. Writers are
+	// serialised, so concurrent edits are never lost.
+	template<typename F> void modify(F &&fn)
+	{
+		std::lock_guard<std::mutex> lk(writer_mutex);
+		T *next = new T(*current.load());
+		fn(*next);
+		swap_in(next);
+	}
+
+private:
+	void swap_in(T *next)
+	{
+		T *old = current.exchange(next);
+		uint32_t prev = epoch.fetch_xor(1);
+		while (readers[prev].load() != 0)
+			std::this_thread::yield();
+		delete old;
+	}
+
+	std::atomic<T *> current;
+	mutable std::atomic<uint32_t> epoch{0};
+	mutable std::atomic<uint32_t> readers[2]{};
+	std::mutex writer_mutex;
+};
@@ -0,0 +1,446 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "remote-cache.h"
+#include "media-index.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// A download that keeps failing is given up until it is
+// requested again
+static constexpr int MAX_ATTEMPTS = 3;
+static constexpr int CHUNK = 256 * 1024;
+static constexpr const char *PART = ".part";
+
+enum class remote_state { pending, ready };
+
+struct remote_entry {
+	remote_state state = remote_state::pending;
+	std::string path; // the local copy
+	uint64_t size = 0;
+	std::list<std::string>::iterator lru; // ready entries only
+};
+
+struct remote_job {
+	std::string url;
+	std::string key;
+	int attempts;
+};
+
+static struct {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::unordered_map<std::string, remote_entry> entries;
+	std::list<std::string> lru; // keys, least recent first
+	std::deque<remote_job> queue;
+	std::thread worker;
+	std::atomic<bool> stop{false};
+	std::string dir;
+	uint64_t limit = 2048ULL * 1024 * 1024;
+	uint64_t bytes = 0; // of ready entries
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t downloaded = 0;
+	uint64_t resumed = 0;
+	uint64_t failed = 0;
+	uint64_t evicted = 0;
+} s_remote;
+
+// FNV-1a, so copies keep their names across runs and builds
+static std::string url_key(const std::string &url)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : url) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	char buf[24];
+	snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+	return buf;
+}
+
+// The URL's extension, which is_still_image and ffmpeg's
+// probing go by; query and fragment are not part of it
+static std::string url_ext(const std::string &url)
+{
+	size_t end = url.find_first_of("?#", url.find("://") + 3);
+	if (end == std::string::npos)
+		end = url.size();
+	size_t slash = url.rfind('/', end - 1);
+	size_t dot = url.rfind('.', end - 1);
+	if (dot == std::string::npos ||
+	    (slash != std::string::npos && dot < slash) ||
+	    end - dot > 8)
+		return std::string();
+	std::string ext = url.substr(dot, end - dot);
+	std::transform(ext.begin(), ext.end(), ext.begin(),
+		       [](unsigned char c) { return (char)tolower(c); });
+	return ext;
+}
+
+static std::string local_path(const std::string &key,
+			      const std::string &url)
+{
+	return s_remote.dir + "/" + key + url_ext(url);
+}
+
+// Caller holds the mutex
+static void make_ready(const std::string &key, const std::string &path,
+		       uint64_t size)
+{
+	remote_entry &e = s_remote.entries[key];
+	if (e.state == remote_state::ready) {
+		s_remote.bytes -= e.size;
+		s_remote.lru.erase(e.lru);
+	}
+	e.state = remote_state::ready;
+	e.path = path;
+	e.size = size;
+	e.lru = s_remote.lru.insert(s_remote.lru.end(), key);
+	s_remote.bytes += size;
+}
+
+// Caller holds the mutex. The newest copy is never evicted, so
+// a file larger than the whole cache still plays. A copy that
+// cannot be deleted (open on Windows) is skipped this time.
+static void evict_locked(void)
+{
+	auto it = s_remote.lru.begin();
+	while (s_remote.bytes > s_remote.limit &&
+	       it != s_remote.lru.end() &&
+	       std::next(it) != s_remote.lru.end()) {
+		auto e = s_remote.entries.find(*it);
+		if (os_unlink(e->second.path.c_str()) != 0 &&
+		    os_file_exists(e->second.path.c_str())) {
+			++it;
+			continue;
+		}
+		s_remote.bytes -= e->second.size;
+		s_remote.entries.erase(e);
+		it = s_remote.lru.erase(it);
+		s_remote.evicted++;
+	}
+}
+
+// Copies on disk from earlier runs, oldest modification first
+// as the starting LRU order; stray .part files stay for resume
+static void load_existing(void)
+{
+	os_dir_t *d = os_opendir(s_remote.dir.c_str());
+	if (!d)
+		return;
+	struct found {
+		std::string key;
+		std::string path;
+		uint64_t size;
+		int64_t mtime;
+	};
+	std::vector<found> all;
+	struct os_dirent *ent;
+	while ((ent = os_readdir(d))) {
+		std::string name = ent->d_name;
+		if (ent->directory || name.size() < 16 ||
+		    name.find(PART) != std::string::npos)
+			continue;
+		std::string path = s_remote.dir + "/" + name;
+		struct stat st;
+		if (os_stat(path.c_str(), &st) != 0)
+			continue;
+		all.push_back({name.substr(0, 16), path,
+			       (uint64_t)st.st_size, (int64_t)st.st_mtime});
+	}
+	os_closedir(d);
+
+	std::sort(all.begin(), all.end(),
+		  [](const found &a, const found &b) {
+			  return a.mtime < b.mtime;
+		  });
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	for (const found &f : all)
+		make_ready(f.key, f.path, f.size);
+	evict_locked();
+	if (!all.empty())
+		blog(LOG_INFO,
+		     "[RandomMedia] Remote cache: %zu file(s), %.1f MB",
+		     s_remote.entries.size(),
+		     (double)s_remote.bytes / (1024.0 * 1024.0));
+}
+
+// ============================================================
+//  Download
+// ============================================================
+static int interrupt_cb(void *)
+{
+	return s_remote.stop ? 1 : 0;
+}
+
+// Fetches 'url' into 'dest', continuing an existing .part with
+// a range request. Servers that cannot seek start over.
+static bool download(const std::string &url, const std::string &dest,
+		     uint64_t &size)
+{
+	std::string part = dest + PART;
+	int64_t have = os_get_file_size(part.c_str());
+	if (have < 0)
+		have = 0;
+
+	AVIOInterruptCB cb = {interrupt_cb, nullptr};
+	AVDictionary *opts = nullptr;
+	av_dict_set(&opts, "reconnect", "1", 0);
+	av_dict_set(&opts, "rw_timeout", "15000000", 0); // 15 s
+	AVIOContext *io = nullptr;
+	int ret = avio_open2(&io, url.c_str(), AVIO_FLAG_READ, &cb, &opts);
+	av_dict_free(&opts);
+	if (ret < 0)
+		return false;
+
+	int64_t total = avio_size(io);
+	if (have && total > 0 && have > total)
+		have = 0; // not this file's prefix any more
+	if (have && avio_seek(io, have, SEEK_SET) != have)
+		have = 0;
+	if (have) {
+		std::lock_guard<std::mutex> lk(s_remote.mutex);
+		s_remote.resumed++;
+	}
+
+	FILE *f = os_fopen(part.c_str(), have ? "ab" : "wb");
+	if (!f) {
+		avio_closep(&io);
+		return false;
+	}
+	std::vector<unsigned char> buf(CHUNK);
+	uint64_t got = (uint64_t)have;
+	bool ok = false;
+	for (;;) {
+		int n = avio_read(io, buf.data(), CHUNK);
+		if (n == AVERROR_EOF || n == 0) {
+			ok = true;
+			break;
+		}
+		if (n < 0 || fwrite(buf.data(), 1, (size_t)n, f) !=
+				     (size_t)n)
+			break;
+		got += (uint64_t)n;
+		std::lock_guard<std::mutex> lk(s_remote.mutex);
+		s_remote.downloaded += (uint64_t)n;
+	}
+	ok = fclose(f) == 0 && ok;
+	avio_closep(&io);
+
+	// A short read keeps the .part for the next attempt
+	if (!ok || (total > 0 && got != (uint64_t)total))
+		return false;
+	os_unlink(dest.c_str());
+	if (os_rename(part.c_str(), dest.c_str()) != 0)
+		return false;
+	size = got;
+	return true;
+}
+
+static void process_job(remote_job &job)
+{
+	std::string dest = local_path(job.key, job.url);
+	uint64_t start = os_gettime_ns();
+	uint64_t size = 0;
+	if (download(job.url, dest, size)) {
+		media_index_refresh(dest);
+		std::lock_guard<std::mutex> lk(s_remote.mutex);
+		make_ready(job.key, dest, size);
+		evict_locked();
+		blog(LOG_INFO,
+		     "[RandomMedia] Cached %.1f MB in %.1f s: %s",
+		     (double)size / (1024.0 * 1024.0),
+		     (double)(os_gettime_ns() - start) / 1e9,
+		     job.url.c_str());
+		return;
+	}
+	if (s_remote.stop)
+		return;
+
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	if (++job.attempts < MAX_ATTEMPTS) {
+		s_remote.queue.push_back(std::move(job));
+		return;
+	}
+	s_remote.failed++;
+	s_remote.entries.erase(job.key);
+	blog(LOG_WARNING, "[RandomMedia] Download failed: %s",
+	     job.url.c_str());
+}
+
+static void remote_worker_loop(void)
+{
+	os_set_thread_name("random-media: download");
+
+	std::unique_lock<std::mutex> lk(s_remote.mutex);
+	for (;;) {
+		s_remote.cv.wait(lk, [] {
+			return s_remote.stop || !s_remote.queue.empty();
+		});
+		if (s_remote.stop)
+			break;
+
+		remote_job job = std::move(s_remote.queue.front());
+		s_remote.queue.pop_front();
+		lk.unlock();
+		process_job(job);
+		lk.lock();
+	}
+}
+
+// ============================================================
+//  Public API
+// ============================================================
+bool remote_is_url(std::string_view path)
+{
+	return path.substr(0, 7) == "http://" ||
+	       path.substr(0, 8) == "https://";
+}
+
+void remote_cache_init(void)
+{
+	char *dir = obs_module_config_path("remote");
+	if (dir) {
+		os_mkdirs(dir);
+		s_remote.dir = dir;
+		bfree(dir);
+	}
+	avformat_network_init();
+	load_existing();
+	s_remote.stop = false;
+	s_remote.worker = std::thread(remote_worker_loop);
+}
+
+void remote_cache_free(void)
+{
+	{
+		std::lock_guard<std::mutex> lk(s_remote.mutex);
+		s_remote.stop = true;
+	}
+	s_remote.cv.notify_all();
+	if (s_remote.worker.joinable())
+		s_remote.worker.join();
+
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	s_remote.entries.clear();
+	s_remote.lru.clear();
+	s_remote.queue.clear();
+	s_remote.bytes = 0;
+	avformat_network_deinit();
+}
+
+void remote_cache_set_limit(uint64_t max_bytes)
+{
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	s_remote.limit = max_bytes;
+	evict_locked();
+}
+
+void remote_cache_request(const std::string &url)
+{
+	if (s_remote.dir.empty())
+		return;
+	std::string key = url_key(url);
+	{
+		std::lock_guard<std::mutex> lk(s_remote.mutex);
+		if (s_remote.entries.count(key))
+			return;
+		s_remote.entries[key] = remote_entry();
+		s_remote.queue.push_back({url, std::move(key), 0});
+	}
+	s_remote.cv.notify_one();
+}
+
+bool remote_cache_lookup(const std::string &url, std::string &local)
+{
+	std::string key = url_key(url);
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	auto it = s_remote.entries.find(key);
+	if (it == s_remote.entries.end() ||
+	    it->second.state != remote_state::ready) {
+		s_remote.misses++;
+		return false;
+	}
+	s_remote.lru.splice(s_remote.lru.end(), s_remote.lru,
+			    it->second.lru);
+	s_remote.hits++;
+	local = it->second.path;
+	return true;
+}
+
+bool remote_cache_fetch(const std::string &url, std::string &local)
+{
+	if (s_remote.dir.empty())
+		return false;
+	std::string key = url_key(url);
+	std::string dest = local_path(key, url);
+	// Always the current version, never a resumed old one
+	std::string part = dest + PART;
+	os_unlink(part.c_str());
+
+	uint64_t size = 0;
+	bool ok = download(url, dest, size);
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	if (ok) {
+		make_ready(key, dest, size);
+		evict_locked();
+	}
+	auto it = s_remote.entries.find(key);
+	if (it == s_remote.entries.end() ||
+	    it->second.state != remote_state::ready)
+		return false;
+	if (!ok)
+		blog(LOG_WARNING,
+		     "[RandomMedia] Download failed, using cached copy: %s",
+		     url.c_str());
+	local = it->second.path;
+	return true;
+}
+
+void remote_cache_stats(remote_cache_counters &out)
+{
+	std::lock_guard<std::mutex> lk(s_remote.mutex);
+	out = remote_cache_counters();
+	out.files = s_remote.lru.size();
+	out.bytes = s_remote.bytes;
+	out.pending = s_remote.entries.size() - s_remote.lru.size();
+	out.hits = s_remote.hits;
+	out.misses = s_remote.misses;
+	out.downloaded = s_remote.downloaded;
+	out.resumed = s_remote.resumed;
+	out.failed = s_remote.failed;
+	out.evicted = s_remote.evicted;
+}
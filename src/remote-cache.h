@@ -0,0 +1,73 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// ============================================================
+//  Remote cache
+// ============================================================
+// HTTP(S) media is never played from the network. A download
+// worker copies requested URLs into the module config
+// directory, in request order, and spawns only ever get the
+// local copy. Interrupted downloads keep their .part file and
+// resume with a range request. The cache is bounded in bytes;
+// the least recently used copies are evicted first.
+//
+// Copies are named after a hash of the URL, so they survive
+// restarts without an index file.
+struct remote_cache_counters {
+	size_t files = 0;   // complete copies on disk
+	uint64_t bytes = 0; // their total size
+	size_t pending = 0; // queued or downloading
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t downloaded = 0; // bytes fetched this session
+	uint64_t resumed = 0;    // downloads continued from a .part
+	uint64_t failed = 0;
+	uint64_t evicted = 0;
+};
+
+// http:// or https://
+bool remote_is_url(std::string_view path);
+
+// Loads what is already on disk and starts the worker
+void remote_cache_init(void);
+// Stops the worker; a download in progress keeps its .part
+void remote_cache_free(void);
+
+// Evicts down to 'max_bytes' straight away if over it
+void remote_cache_set_limit(uint64_t max_bytes);
+
+// Queues 'url' behind earlier requests unless it is cached or
+// already queued
+void remote_cache_request(const std::string &url);
+
+// The local copy of 'url', marked as recently used; false
+// while there is none
+bool remote_cache_lookup(const std::string &url, std::string &local);
+
+// Downloads 'url' on the calling thread, replacing any cached
+// copy — for manifests, which change in place. Falls back to
+// the cached copy if the download fails.
+bool remote_cache_fetch(const std::string &url, std::string &local);
+
+void remote_cache_stats(remote_cache_counters &out);
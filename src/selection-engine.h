@@ -0,0 +1,259 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <utility>
+#include <vector>
+
+// ============================================================
+//  Seeding
+// ============================================================
+// random_device can be a syscall, so generators are seeded
+// from it once — mixed with the clock, in case it is a fixed
+// sequence — and then kept.
+template<typename G> G seeded_rng()
+{
+	std::random_device rd;
+	uint64_t t = (uint64_t)std::chrono::high_resolution_clock::now()
+			     .time_since_epoch()
+			     .count();
+	std::seed_seq seq{rd(), rd(), rd(), rd(), (uint32_t)t,
+			  (uint32_t)(t >> 32)};
+	return G(seq);
+}
+
+// One generator per thread, for transforms and placement
+inline std::mt19937 &thread_rng()
+{
+	thread_local std::mt19937 gen = seeded_rng<std::mt19937>();
+	return gen;
+}
+
+// ============================================================
+//  Alias table
+// ============================================================
+// Vose's alias method: O(n) to build, O(1) per weighted pick —
+// one uniform index and one coin flip. Zero or negative
+// weights are never picked; if no weight is positive every
+// entry is equally likely.
+class alias_table {
+public:
+	void build(const std::vector<double> &weights)
+	{
+		size_t n = weights.size();
+		prob.assign(n, 1.0f);
+		alias.resize(n);
+		for (size_t i = 0; i < n; ++i)
+			alias[i] = (uint32_t)i;
+		double sum = 0.0;
+		for (double w : weights)
+			sum += std::max(w, 0.0);
+		if (sum <= 0.0)
+			return;
+
+		std::vector<double> p(n);
+		std::vector<uint32_t> small, large;
+		for (size_t i = 0; i < n; ++i) {
+			p[i] = std::max(weights[i], 0.0) * (double)n / sum;
+			(p[i] < 1.0 ? small : large).push_back((uint32_t)i);
+		}
+		while (!small.empty() && !large.empty()) {
+			uint32_t s = small.back();
+			uint32_t l = large.back();
+			small.pop_back();
+			prob[s] = (float)p[s];
+			alias[s] = l;
+			p[l] += p[s] - 1.0;
+			if (p[l] < 1.0) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		// Whatever is left is 1 up to rounding
+		for (uint32_t i : small)
+			prob[i] = 1.0f;
+		for (uint32_t i : large)
+			prob[i] = 1.0f;
+	}
+
+	template<typename G> uint32_t sample(G &gen) const
+	{
+		std::uniform_int_distribution<uint32_t> pick(
+			0, (uint32_t)prob.size() - 1);
+		std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+		uint32_t i = pick(gen);
+		return coin(gen) < prob[i] ? i : alias[i];
+	}
+
+	size_t size() const { return prob.size(); }
+
+private:
+	std::vector<float> prob;
+	std::vector<uint32_t> alias;
+};
+
+// ============================================================
+//  Selection engine
+// ============================================================
+// Decides which catalog entries come next, owned by one source
+// and kept across triggers:
+//
+//  - random: independent picks, weighted through the alias
+//    table, so an entry can repeat
+//  - shuffle: a bag that deals every entry once per round.
+//    Weighted bags are ordered by an exponential race, so
+//    heavy entries tend to come early in each round. The last
+//    entry of a round never opens the next one.
+//
+// Picks are decided ahead into a queue, so callers can see
+// exactly what comes next (peek) and take the first upcoming
+// entry that is ready (take_first) without reordering the
+// rest.
+//
+// Picks need at least one entry. Not thread-safe: callers
+// serialise access.
+class selection_engine {
+public:
+	enum class mode { random, shuffle };
+
+	selection_engine() : gen(seeded_rng<std::mt19937_64>()) {}
+
+	// 'weights' is empty or one per entry; anything already
+	// decided is dropped
+	void reset(size_t count, std::vector<double> weights, mode m)
+	{
+		n = (uint32_t)count;
+		how = m;
+		w = std::move(weights);
+		weighted = !w.empty();
+		if (weighted)
+			table.build(w);
+		else
+			table = alias_table();
+		bag.clear();
+		bag_pos = 0;
+		ahead.clear();
+		has_last = false;
+	}
+
+	size_t size() const { return n; }
+
+	// The next entry, consumed
+	uint32_t next()
+	{
+		if (ahead.empty())
+			return draw();
+		uint32_t i = ahead.front();
+		ahead.pop_front();
+		return i;
+	}
+
+	// An independent pick that leaves the order untouched,
+	// e.g. for a replacement candidate
+	uint32_t sample()
+	{
+		if (weighted)
+			return table.sample(gen);
+		std::uniform_int_distribution<uint32_t> pick(0, n - 1);
+		return pick(gen);
+	}
+
+	// The next 'k' entries, deciding them if need be
+	const std::deque<uint32_t> &peek(size_t k)
+	{
+		while (ahead.size() < k)
+			ahead.push_back(draw());
+		return ahead;
+	}
+
+	// Consumes the first of the next 'window' entries that
+	// satisfies 'ready'; false if none does
+	template<typename P>
+	bool take_first(P &&ready, size_t window, uint32_t &out)
+	{
+		peek(std::max<size_t>(window, 1));
+		for (size_t i = 0; i < ahead.size() && i < window; ++i) {
+			if (!ready(ahead[i]))
+				continue;
+			out = ahead[i];
+			ahead.erase(ahead.begin() + (ptrdiff_t)i);
+			return true;
+		}
+		return false;
+	}
+
+private:
+	uint32_t draw()
+	{
+		if (how == mode::random)
+			return sample();
+		if (bag_pos == bag.size())
+			deal();
+		uint32_t i = bag[bag_pos++];
+		last = i;
+		has_last = true;
+		return i;
+	}
+
+	void deal()
+	{
+		bag.clear();
+		if (weighted) {
+			// Sorting by E/w is sampling without
+			// replacement in proportion to w; entries
+			// weighted 0 sit out
+			std::exponential_distribution<double> e(1.0);
+			std::vector<std::pair<double, uint32_t>> keys;
+			for (uint32_t i = 0; i < n; ++i)
+				if (w[i] > 0.0)
+					keys.push_back({e(gen) / w[i], i});
+			std::sort(keys.begin(), keys.end());
+			for (const auto &k : keys)
+				bag.push_back(k.second);
+		}
+		if (bag.empty()) {
+			bag.resize(n);
+			for (uint32_t i = 0; i < n; ++i)
+				bag[i] = i;
+			std::shuffle(bag.begin(), bag.end(), gen);
+		}
+		if (bag.size() > 1 && has_last && bag[0] == last) {
+			std::uniform_int_distribution<size_t> pick(
+				1, bag.size() - 1);
+			std::swap(bag[0], bag[pick(gen)]);
+		}
+		bag_pos = 0;
+	}
+
+	std::mt19937_64 gen;
+	uint32_t n = 0;
+	mode how = mode::random;
+	bool weighted = false;
+	std::vector<double> w;
+	alias_table table;
+	std::vector<uint32_t> bag;
+	size_t bag_pos = 0;
+	std::deque<uint32_t> ahead;
+	uint32_t last = 0;
+	bool has_last = false;
+};
@@ -0,0 +1,121 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ============================================================
+//  Slot table
+// ============================================================
+// Fixed-capacity table addressed by 64-bit handles: the low 32
+// bits are the slot index, the high 32 bits the slot's
+// generation. Freeing a slot bumps its generation, so a stale
+// handle never reaches the slot's next occupant. Insert and
+// remove are O(1) through a free list; handle 0 is never
+// issued.
+//
+// Not thread-safe: callers serialise access.
+template<typename T> class slot_table {
+public:
+	explicit slot_table(uint32_t capacity) : slots(capacity)
+	{
+		free_list.reserve(capacity);
+		for (uint32_t i = capacity; i > 0; --i)
+			free_list.push_back(i - 1);
+	}
+
+	// Returns 0 when the table is full
+	uint64_t insert(T value)
+	{
+		if (free_list.empty())
+			return 0;
+		uint32_t idx = free_list.back();
+		free_list.pop_back();
+		slot &s = slots[idx];
+		s.value = value;
+		s.used = true;
+		count++;
+		return ((uint64_t)s.gen << 32) | idx;
+	}
+
+	// Value of a live handle, or nullptr
+	T *find(uint64_t h)
+	{
+		slot *s = lookup(h);
+		return s ? &s->value : nullptr;
+	}
+
+	// Frees the slot and hands back its value if 'h' is live
+	bool take(uint64_t h, T &out)
+	{
+		slot *s = lookup(h);
+		if (!s)
+			return false;
+		out = s->value;
+		release(*s, (uint32_t)h);
+		return true;
+	}
+
+	// Frees every slot whose value matches 'pred', appending
+	// the values to 'out'
+	template<typename P> void take_if(P &&pred, std::vector<T> &out)
+	{
+		for (uint32_t i = 0; i < (uint32_t)slots.size(); ++i) {
+			if (!slots[i].used || !pred(slots[i].value))
+				continue;
+			out.push_back(slots[i].value);
+			release(slots[i], i);
+		}
+	}
+
+	size_t size() const { return count; }
+	size_t capacity() const { return slots.size(); }
+
+private:
+	struct slot {
+		uint32_t gen = 1;
+		bool used = false;
+		T value{};
+	};
+
+	slot *lookup(uint64_t h)
+	{
+		uint32_t idx = (uint32_t)h;
+		uint32_t gen = (uint32_t)(h >> 32);
+		if (idx >= slots.size())
+			return nullptr;
+		slot &s = slots[idx];
+		return s.used && s.gen == gen ? &s : nullptr;
+	}
+
+	void release(slot &s, uint32_t idx)
+	{
+		s.used = false;
+		s.value = T{};
+		if (++s.gen == 0)
+			s.gen = 1; // keep handles non-zero
+		free_list.push_back(idx);
+		count--;
+	}
+
+	std::vector<slot> slots;
+	std::vector<uint32_t> free_list;
+	size_t count = 0;
+};
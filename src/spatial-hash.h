@@ -0,0 +1,133 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================
+//  Spatial hash
+// ============================================================
+// Axis-aligned boxes bucketed by a uniform grid of square
+// cells, the cells hashed into a fixed bucket array. An overlap
+// test only looks at boxes listed under the cells the query
+// touches, so it stays O(1) on average however many boxes there
+// are, as long as boxes are roughly a cell in size. A box is
+// listed once for every cell it touches.
+//
+// Not thread-safe: callers serialise access.
+struct aabb {
+	float x0, y0; // top-left
+	float x1, y1; // bottom-right
+};
+
+class spatial_hash {
+public:
+	static constexpr size_t BUCKETS = 4096;
+	static constexpr float MIN_CELL = 8.0f;
+
+	explicit spatial_hash(float cell_size)
+		: cell(std::max(cell_size, MIN_CELL)), buckets(BUCKETS)
+	{
+	}
+
+	float cell_size() const { return cell; }
+	size_t size() const { return boxes.size(); }
+
+	// Re-buckets every box for a new cell size
+	void resize(float cell_size)
+	{
+		cell = std::max(cell_size, MIN_CELL);
+		for (std::vector<uint64_t> &b : buckets)
+			b.clear();
+		for (const auto &kv : boxes)
+			link(kv.first, kv.second);
+	}
+
+	void insert(uint64_t id, const aabb &box)
+	{
+		boxes[id] = box;
+		link(id, box);
+	}
+
+	void remove(uint64_t id)
+	{
+		auto it = boxes.find(id);
+		if (it == boxes.end())
+			return;
+		// One entry per covered cell, even when several
+		// cells share a bucket
+		for_cells(it->second, [&](std::vector<uint64_t> &b) {
+			auto e = std::find(b.begin(), b.end(), id);
+			if (e == b.end())
+				return;
+			*e = b.back();
+			b.pop_back();
+		});
+		boxes.erase(it);
+	}
+
+	bool overlaps(const aabb &box)
+	{
+		bool hit = false;
+		for_cells(box, [&](std::vector<uint64_t> &b) {
+			for (size_t i = 0; i < b.size() && !hit; ++i)
+				hit = intersects(boxes[b[i]], box);
+		});
+		return hit;
+	}
+
+private:
+	static bool intersects(const aabb &a, const aabb &b)
+	{
+		return a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 &&
+		       b.y0 < a.y1;
+	}
+
+	template<typename F> void for_cells(const aabb &box, F &&f)
+	{
+		int64_t cx0 = (int64_t)std::floor(box.x0 / cell);
+		int64_t cy0 = (int64_t)std::floor(box.y0 / cell);
+		int64_t cx1 = (int64_t)std::floor(box.x1 / cell);
+		int64_t cy1 = (int64_t)std::floor(box.y1 / cell);
+		for (int64_t cy = cy0; cy <= cy1; ++cy)
+			for (int64_t cx = cx0; cx <= cx1; ++cx)
+				f(buckets[bucket_of(cx, cy)]);
+	}
+
+	static size_t bucket_of(int64_t cx, int64_t cy)
+	{
+		uint64_t h = (uint64_t)cx * 73856093ULL ^
+			     (uint64_t)cy * 19349663ULL;
+		return (size_t)(h % BUCKETS);
+	}
+
+	void link(uint64_t id, const aabb &box)
+	{
+		for_cells(box, [&](std::vector<uint64_t> &b) {
+			b.push_back(id);
+		});
+	}
+
+	float cell;
+	std::vector<std::vector<uint64_t>> buckets;
+	std::unordered_map<uint64_t, aabb> boxes;
+};
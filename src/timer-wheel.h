@@ -0,0 +1,92 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// ============================================================
+//  Hashed timer wheel
+// ============================================================
+// Timers hash into SLOTS buckets by their expiry tick, so each
+// elapsed tick visits a single bucket no matter how many timers
+// are pending; timers further out than one revolution simply
+// stay in their bucket until their tick comes round.
+//
+// Not thread-safe: callers serialise access. Cancelling is the
+// caller's job too — expired IDs that are no longer live should
+// be ignored, which keeps schedule() and advance() O(1).
+class timer_wheel {
+public:
+	static constexpr uint64_t SLOTS = 256;
+
+	timer_wheel(uint64_t resolution_ns, uint64_t start_ns)
+		: resolution(resolution_ns),
+		  current(start_ns / resolution_ns)
+	{
+	}
+
+	void schedule(uint64_t id, uint64_t deadline_ns)
+	{
+		uint64_t tick =
+			std::max(deadline_ns / resolution, current + 1);
+		slots[tick % SLOTS].push_back({id, tick});
+	}
+
+	// Appends every timer due at or before 'now_ns'
+	void advance(uint64_t now_ns, std::vector<uint64_t> &expired)
+	{
+		uint64_t target = now_ns / resolution;
+		if (target <= current)
+			return;
+
+		uint64_t steps = std::min(target - current, SLOTS);
+		for (uint64_t i = 1; i <= steps; ++i) {
+			std::vector<timer> &slot =
+				slots[(current + i) % SLOTS];
+			for (size_t k = 0; k < slot.size();) {
+				if (slot[k].tick > target) {
+					++k;
+					continue;
+				}
+				expired.push_back(slot[k].id);
+				slot[k] = slot.back();
+				slot.pop_back();
+			}
+		}
+		current = target;
+	}
+
+	// Drops every pending timer
+	void clear()
+	{
+		for (std::vector<timer> &slot : slots)
+			slot.clear();
+	}
+
+private:
+	struct timer {
+		uint64_t id;
+		uint64_t tick;
+	};
+
+	std::vector<timer> slots[SLOTS];
+	uint64_t resolution;
+	uint64_t current;
+};
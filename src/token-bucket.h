@@ -0,0 +1,90 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// ============================================================
+//  Token bucket
+// ============================================================
+// Admits 'rate' events per second on average and bursts of up
+// to 'burst' at once. Tokens are refilled lazily from the
+// elapsed time whenever the bucket is used, so an idle bucket
+// costs nothing. A rate of 0 admits everything.
+//
+// Not thread-safe: callers serialise access.
+class token_bucket {
+public:
+	// Keeps the tokens already saved up, capped to the new
+	// burst; a bucket that was unlimited starts out full
+	void configure(double rate_per_sec, double burst_size,
+		       uint64_t now_ns)
+	{
+		refill(now_ns);
+		bool was_limited = limited();
+		rate = std::max(rate_per_sec, 0.0);
+		burst = std::max(burst_size, 1.0);
+		tokens = was_limited ? std::min(tokens, burst) : burst;
+	}
+
+	bool limited() const { return rate > 0.0; }
+
+	bool take(uint64_t now_ns)
+	{
+		if (!limited())
+			return true;
+		refill(now_ns);
+		if (tokens < 1.0)
+			return false;
+		tokens -= 1.0;
+		return true;
+	}
+
+	// Time until take() can next succeed; 0 if it can now
+	uint64_t wait_ns(uint64_t now_ns)
+	{
+		if (!limited())
+			return 0;
+		refill(now_ns);
+		if (tokens >= 1.0)
+			return 0;
+		return (uint64_t)((1.0 - tokens) / rate * 1e9) + 1;
+	}
+
+	double available(uint64_t now_ns)
+	{
+		refill(now_ns);
+		return tokens;
+	}
+
+private:
+	void refill(uint64_t now_ns)
+	{
+		if (now_ns > last_ns && limited())
+			tokens = std::min(burst,
+					  tokens + (double)(now_ns - last_ns) /
+							   1e9 * rate);
+		last_ns = std::max(last_ns, now_ns);
+	}
+
+	double rate = 0.0;
+	double burst = 1.0;
+	double tokens = 1.0;
+	uint64_t last_ns = 0;
+};
@@ -0,0 +1,217 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#include "trace-log.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// ============================================================
+//  Rings
+// ============================================================
+// Each slot is a tiny seqlock: the writer marks it odd while it
+// stores the fields, so an export racing the owner thread skips
+// a half-written event instead of reading it torn.
+static constexpr uint64_t RING_EVENTS = 1024;
+static constexpr size_t MAX_RINGS = 256;
+
+static const char *const s_event_names[(int)trace_event::count] = {
+	"trigger",     "queue", "create",  "scene_add",
+	"first_frame", "end",   "release", "skip",
+};
+
+struct trace_slot {
+	std::atomic<uint64_t> seq{0}; // 2n+2 once event n is complete
+	std::atomic<uint64_t> ts{0};
+	std::atomic<uint64_t> id{0};
+	std::atomic<uint32_t> type{0};
+};
+
+struct trace_ring {
+	uint32_t tid; // export's thread number for the owner
+	std::atomic<uint64_t> head{0}; // events ever written
+	trace_slot slots[RING_EVENTS];
+};
+
+static struct {
+	std::mutex mutex; // guards everything but 'lost'
+	std::vector<trace_ring *> rings;
+	std::vector<trace_ring *> free_rings; // owner thread exited
+	uint64_t gen = 0; // bumped by trace_free
+	std::atomic<uint64_t> lost{0}; // from threads past MAX_RINGS
+} s_trace;
+
+// A ring is only ever written by the thread that holds it.
+// Media threads come and go with every pooled source, so a
+// thread hands its ring back when it exits and the next new
+// thread takes it over; the events already in it stay for
+// export, on the same track. MAX_RINGS bounds the threads
+// tracing at once, not over the session.
+struct ring_owner {
+	trace_ring *ring = nullptr;
+	bool none = false; // every ring was taken
+	uint64_t gen = 0;
+
+	~ring_owner()
+	{
+		if (!ring)
+			return;
+		std::lock_guard<std::mutex> lk(s_trace.mutex);
+		// Rings of an earlier session are gone already
+		if (gen == s_trace.gen)
+			s_trace.free_rings.push_back(ring);
+	}
+};
+static thread_local ring_owner t_owner;
+
+static trace_ring *thread_ring(void)
+{
+	ring_owner &o = t_owner;
+	if (o.ring || o.none)
+		return o.ring;
+	std::lock_guard<std::mutex> lk(s_trace.mutex);
+	o.gen = s_trace.gen;
+	if (!s_trace.free_rings.empty()) {
+		o.ring = s_trace.free_rings.back();
+		s_trace.free_rings.pop_back();
+		return o.ring;
+	}
+	if (s_trace.rings.size() >= MAX_RINGS) {
+		o.none = true;
+		return nullptr;
+	}
+	o.ring = new trace_ring();
+	o.ring->tid = (uint32_t)s_trace.rings.size() + 1;
+	s_trace.rings.push_back(o.ring);
+	return o.ring;
+}
+
+void trace_record_at(trace_event ev, uint64_t id, uint64_t ts_ns)
+{
+	trace_ring *r = thread_ring();
+	if (!r) {
+		s_trace.lost.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	uint64_t n = r->head.load(std::memory_order_relaxed);
+	trace_slot &s = r->slots[n % RING_EVENTS];
+	s.seq.store(2 * n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	s.ts.store(ts_ns, std::memory_order_relaxed);
+	s.id.store(id, std::memory_order_relaxed);
+	s.type.store((uint32_t)ev, std::memory_order_relaxed);
+	s.seq.store(2 * n + 2, std::memory_order_release);
+	r->head.store(n + 1, std::memory_order_release);
+}
+
+void trace_record(trace_event ev, uint64_t id)
+{
+	trace_record_at(ev, id, os_gettime_ns());
+}
+
+// ============================================================
+//  Export
+// ============================================================
+struct trace_copy {
+	uint64_t ts;
+	uint64_t id;
+	uint32_t type;
+	uint32_t tid;
+};
+
+static void copy_ring(trace_ring *r, std::vector<trace_copy> &out)
+{
+	uint64_t head = r->head.load(std::memory_order_acquire);
+	uint64_t first = head > RING_EVENTS ? head - RING_EVENTS : 0;
+	for (uint64_t n = first; n < head; ++n) {
+		trace_slot &s = r->slots[n % RING_EVENTS];
+		if (s.seq.load(std::memory_order_acquire) != 2 * n + 2)
+			continue; // being overwritten
+		trace_copy c;
+		c.ts = s.ts.load(std::memory_order_relaxed);
+		c.id = s.id.load(std::memory_order_relaxed);
+		c.type = s.type.load(std::memory_order_relaxed);
+		c.tid = r->tid;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (s.seq.load(std::memory_order_relaxed) != 2 * n + 2 ||
+		    c.type >= (uint32_t)trace_event::count)
+			continue;
+		out.push_back(c);
+	}
+}
+
+bool trace_export(const std::string &path, size_t &events)
+{
+	std::vector<trace_copy> all;
+	{
+		std::lock_guard<std::mutex> lk(s_trace.mutex);
+		for (trace_ring *r : s_trace.rings)
+			copy_ring(r, all);
+	}
+	std::sort(all.begin(), all.end(),
+		  [](const trace_copy &a, const trace_copy &b) {
+			  return a.ts < b.ts;
+		  });
+
+	// Instant events on one process, a track per thread
+	obs_data_array_t *arr = obs_data_array_create();
+	for (const trace_copy &c : all) {
+		obs_data_t *e = obs_data_create();
+		obs_data_set_string(e, "name", s_event_names[c.type]);
+		obs_data_set_string(e, "ph", "i");
+		obs_data_set_string(e, "s", "t");
+		obs_data_set_double(e, "ts", (double)c.ts / 1000.0);
+		obs_data_set_int(e, "pid", 1);
+		obs_data_set_int(e, "tid", c.tid);
+		obs_data_t *args = obs_data_create();
+		obs_data_set_int(args, "id", (long long)c.id);
+		obs_data_set_obj(e, "args", args);
+		obs_data_release(args);
+		obs_data_array_push_back(arr, e);
+		obs_data_release(e);
+	}
+
+	obs_data_t *root = obs_data_create();
+	obs_data_set_array(root, "traceEvents", arr);
+	obs_data_set_string(root, "displayTimeUnit", "ms");
+	obs_data_set_int(root, "lost_events",
+			 (long long)s_trace.lost.load());
+	bool ok = obs_data_save_json_safe(root, path.c_str(), "tmp",
+					  "bak");
+	obs_data_release(root);
+	obs_data_array_release(arr);
+
+	events = all.size();
+	if (!ok)
+		blog(LOG_WARNING, "[RandomMedia] Cannot write trace: %s",
+		     path.c_str());
+	return ok;
+}
+
+void trace_free(void)
+{
+	std::lock_guard<std::mutex> lk(s_trace.mutex);
+	for (trace_ring *r : s_trace.rings)
+		delete r;
+	s_trace.rings.clear();
+	s_trace.free_rings.clear();
+	s_trace.gen++;
+}
@@ -0,0 +1,56 @@
+/*
+OBS_Random_Media_Source
+Copyright (C) 2026 ClockOrange
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ============================================================
+//  Trace log
+// ============================================================
+// Compact binary spawn events in per-thread ring buffers. Each
+// thread that records gets its own ring on first use, so
+// recording is a handful of relaxed stores with no lock and no
+// formatting; the oldest events are overwritten. Exporting
+// gathers every ring into a Chrome / Perfetto trace file.
+//
+// 'id' is the spawn ticket for trigger, queue and skip events,
+// and the item handle for the rest.
+enum class trace_event : uint8_t {
+	trigger,     // spawn requested
+	queue,       // request left the spawn queue
+	create,      // source prepared for an item
+	scene_add,   // item on screen
+	first_frame, // media_started
+	end,         // media_ended
+	release,     // item retired
+	skip,        // request or file dropped
+	count
+};
+
+void trace_record(trace_event ev, uint64_t id);
+// Same, for an event that happened at 'ts_ns' (os_gettime_ns)
+void trace_record_at(trace_event ev, uint64_t id, uint64_t ts_ns);
+
+// Writes every buffered event to 'path' as Chrome trace JSON;
+// false if the file could not be written
+bool trace_export(const std::string &path, size_t &events);
+
+// Frees the rings; only once nothing records any more
+void trace_free(void);